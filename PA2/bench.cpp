@@ -0,0 +1,86 @@
+#include "hashtable.hpp"
+#include "cuckoo_hashtable.hpp"
+#include "hash_function.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Throughput and bucket distribution of the bundled hash functions over HashTable
+// Usage: ./bench [number of keys]
+
+template<typename Key, typename Hash>
+void benchHash(const char *name, const vector<Key> &keys) {
+    Hash hash;
+    size_t sink = 0;
+    auto start = chrono::steady_clock::now();
+    for (int round = 0; round < 10; round++) {
+        for (const auto &key : keys) sink += hash(key);
+    }
+    auto end = chrono::steady_clock::now();
+    double ns = (double) chrono::duration_cast<chrono::nanoseconds>(end - start).count() / (10.0 * (double) keys.size());
+
+    HashTable<Key, int, Hash> table;
+    start = chrono::steady_clock::now();
+    for (const auto &key : keys) table.insert(key, 0);
+    end = chrono::steady_clock::now();
+    double insertMs = (double) chrono::duration_cast<chrono::microseconds>(end - start).count() / 1000.0;
+
+    // bucket distribution, an ideal hash gives chi^2 / buckets close to 1
+    vector<size_t> load(table.bucketSize(), 0);
+    for (const auto &key : keys) load[hash(key) % table.bucketSize()]++;
+    size_t longest = 0, empty = 0;
+    double expected = (double) keys.size() / (double) load.size(), chi2 = 0;
+    for (auto l : load) {
+        if (l > longest) longest = l;
+        if (l == 0) empty++;
+        chi2 += ((double) l - expected) * ((double) l - expected) / expected;
+    }
+    printf("%-22s %8.2f ns/key  insert %9.2f ms  longest chain %3zu  empty %5.1f%%  chi2/buckets %6.3f  (%zx)\n",
+           name, ns, insertMs, longest, 100.0 * (double) empty / (double) load.size(), chi2 / (double) load.size(),
+           sink & 0xf);
+}
+
+template<typename Table, typename Key>
+void benchLookup(const char *name, const vector<Key> &keys, const vector<Key> &missing) {
+    Table table;
+    for (const auto &key : keys) table.insert(key, 0);
+    size_t found = 0;
+    auto start = chrono::steady_clock::now();
+    for (const auto &key : keys) found += table.contains(key);
+    for (const auto &key : missing) found += table.contains(key);
+    auto end = chrono::steady_clock::now();
+    double ns = (double) chrono::duration_cast<chrono::nanoseconds>(end - start).count() /
+                (double) (keys.size() + missing.size());
+    printf("%-22s %8.2f ns/lookup  load factor %.3f  hits %zu\n", name, ns, table.loadFactor(), found);
+}
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? stoul(argv[1]) : 200000;
+
+    vector<unsigned long> ids(n);
+    for (size_t i = 0; i < n; i++) ids[i] = i * 64;     // sequential ids with a common stride
+    puts("sequential integer ids (stride 64)");
+    benchHash<unsigned long, std::hash<unsigned long>>("std::hash", ids);
+    benchHash<unsigned long, HashFunction::FastHash<unsigned long>>("FastHash", ids);
+    benchHash<unsigned long, HashFunction::IntegerHash<unsigned long>>("IntegerHash", ids);
+    benchHash<unsigned long, HashFunction::SipHash<unsigned long>>("SipHash", ids);
+
+    vector<string> words(n);
+    for (size_t i = 0; i < n; i++) words[i] = "request/" + to_string(i) + "/payload";
+    puts("strings");
+    benchHash<string, std::hash<string>>("std::hash", words);
+    benchHash<string, HashFunction::FastHash<string>>("FastHash", words);
+    benchHash<string, HashFunction::SipHash<string>>("SipHash", words);
+
+    vector<unsigned long> missing(n);
+    for (size_t i = 0; i < n; i++) missing[i] = i * 64 + 1;
+    puts("lookups, half hits and half misses");
+    benchLookup<HashTable<unsigned long, int, HashFunction::IntegerHash<unsigned long>>>("HashTable", ids, missing);
+    benchLookup<CuckooHashTable<unsigned long, int, HashFunction::IntegerHash<unsigned long>>>("CuckooHashTable", ids,
+                                                                                               missing);
+    return 0;
+}
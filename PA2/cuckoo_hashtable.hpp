@@ -0,0 +1,610 @@
+#ifndef VE281P2_CUCKOO_HASHTABLE_HPP
+#define VE281P2_CUCKOO_HASHTABLE_HPP
+
+#include "hash_prime.hpp"
+#include "hash_function.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * The CuckooHashTable class, a drop-in replacement of HashTable with O(1) worst-case lookups
+ * Every key lives in one of its two candidate buckets (4 slots each) or in a small stash,
+ * so a lookup reads at most two buckets plus the stash
+ * Inserting into a full candidate bucket kicks a resident key to its alternative bucket;
+ * a kick chain longer than MAX_KICKS is treated as a cycle, the key goes to the stash,
+ * and the table is rehashed with a new seed (and more buckets if needed) once the stash is full
+ * The time complexity of functions are based on n and k
+ * n is the size of the hashtable
+ * k is the length of Key
+ * @tparam Key          key type
+ * @tparam Value        data type
+ * @tparam Hash         function object, return the hash value of a key
+ * @tparam KeyEqual     function object, return whether two keys are the same
+ */
+template<
+        typename Key, typename Value,
+        typename Hash = std::hash<Key>,
+        typename KeyEqual = std::equal_to<Key>
+>
+class CuckooHashTable {
+public:
+    typedef std::pair<const Key, Value> HashNode;
+    static constexpr size_t SLOTS = 4;          // slots per bucket
+    static constexpr size_t STASH_SIZE = 4;     // keys that failed to be placed by kicking
+    static constexpr size_t MAX_KICKS = 256;    // longest kick chain before giving up
+
+protected:
+    typedef std::optional<HashNode> Slot;
+
+    struct Bucket {
+        Slot slots[SLOTS];
+    };
+
+    typedef std::vector<Bucket> CuckooTableData;
+
+public:
+    /**
+     * A single directional iterator for the hashtable
+     * It walks through the slots of all buckets, then the stash
+     */
+    class Iterator {
+    private:
+        CuckooHashTable *hashTable;
+        size_t pos;                 // global slot position, see CuckooHashTable::slotAt
+
+        Iterator(CuckooHashTable *hashTable, size_t pos) : hashTable(hashTable), pos(pos) {}
+
+        /**
+         * Increment the iterator
+         * Time complexity: Amortized O(1)
+         */
+        void increment() {
+            size_t endPos = hashTable->endPos();
+            if (pos >= endPos) return;
+            while (++pos < endPos && !hashTable->slotAt(pos));
+        }
+
+    public:
+        friend class CuckooHashTable;
+
+        Iterator() = delete;
+
+        Iterator(const Iterator &) = default;
+
+        Iterator &operator=(const Iterator &) = default;
+
+        Iterator &operator++() {
+            increment();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator temp = *this;
+            increment();
+            return temp;
+        }
+
+        bool operator==(const Iterator &that) const {
+            return pos == that.pos;
+        }
+
+        bool operator!=(const Iterator &that) const {
+            return pos != that.pos;
+        }
+
+        HashNode *operator->() {
+            return &*hashTable->slotAt(pos);
+        }
+
+        HashNode &operator*() {
+            return *hashTable->slotAt(pos);
+        }
+    };
+
+protected:
+    static constexpr double DEFAULT_LOAD_FACTOR = 0.9;                      // default maximum load factor is 0.9
+    static constexpr size_t DEFAULT_BUCKET_SIZE = HashPrime::g_a_sizes[0];  // default number of buckets is 5
+    static constexpr size_t NOT_FOUND = SIZE_MAX;
+
+    CuckooTableData buckets;                // buckets of SLOTS slots each
+    std::vector<Slot> stash;                // STASH_SIZE overflow slots
+    size_t stashCount = 0;                  // number of keys in the stash
+
+    size_t tableSize = 0;                   // number of elements
+    double maxLoadFactor;                   // maximum load factor
+    uint64_t seed;                          // derives the two bucket indices from a hash value
+    uint64_t kickState;                     // state of the pseudo random victim selection
+    Hash hash;                              // hash function instance
+    KeyEqual keyEqual;                      // key equal function instance
+
+    /**
+     * Enables the overloads taking a key of type K if both Hash and KeyEqual declare is_transparent
+     */
+    template<typename H, typename E>
+    using Transparent = std::void_t<typename H::is_transparent, typename E::is_transparent>;
+
+    size_t endPos() const { return buckets.size() * SLOTS + STASH_SIZE; }
+
+    Slot &slotAt(size_t pos) {
+        size_t base = buckets.size() * SLOTS;
+        if (pos < base) return buckets[pos / SLOTS].slots[pos % SLOTS];
+        return stash[pos - base];
+    }
+
+    /**
+     * Time Complexity: O(1)
+     * @param hashValue the hash value of a key
+     * @param which 0 for the first candidate bucket, 1 for the second
+     * @return the index of a candidate bucket, the two candidates are always different
+     */
+    size_t bucketIndex(size_t hashValue, int which) const {
+        size_t n = buckets.size();
+        uint64_t mixed = HashFunction::mix64(hashValue ^ seed);
+        // map to [0, n) with a multiply-high instead of a division
+        size_t first = (size_t) (((__uint128_t) mixed * n) >> 64);
+        if (which == 0) return first;
+        size_t second = (size_t) (((__uint128_t) (mixed * 0x9e3779b97f4a7c15ull) * n) >> 64);
+        return second == first ? (first + 1) % n : second;
+    }
+
+    uint64_t nextRandom() {
+        kickState ^= kickState << 13;
+        kickState ^= kickState >> 7;
+        kickState ^= kickState << 17;
+        return kickState;
+    }
+
+    /**
+     * Find the global slot position of a key
+     * Reads at most two buckets and the stash
+     * Time Complexity: O(k)
+     * @param key
+     * @param hashValue hash(key)
+     * @return the slot position, or NOT_FOUND
+     */
+    template<typename K>
+    size_t locate(const K &key, size_t hashValue) const {
+        for (int which = 0; which < 2; which++) {
+            size_t b = bucketIndex(hashValue, which);
+            const Bucket &bucket = buckets[b];
+            for (size_t s = 0; s < SLOTS; s++) {
+                if (bucket.slots[s] && keyEqual(bucket.slots[s]->first, key)) return b * SLOTS + s;
+            }
+        }
+        if (stashCount) {
+            for (size_t s = 0; s < STASH_SIZE; s++) {
+                if (stash[s] && keyEqual(stash[s]->first, key)) return buckets.size() * SLOTS + s;
+            }
+        }
+        return NOT_FOUND;
+    }
+
+    /**
+     * Try to place a node in an empty slot of one of its candidate buckets
+     * Time Complexity: O(k)
+     * @return whether the node is placed
+     */
+    bool placeDirect(Slot &carry) {
+        size_t hashValue = hash(carry->first);
+        for (int which = 0; which < 2; which++) {
+            Bucket &bucket = buckets[bucketIndex(hashValue, which)];
+            for (size_t s = 0; s < SLOTS; s++) {
+                if (!bucket.slots[s]) {
+                    bucket.slots[s].emplace(std::move(*carry));
+                    carry.reset();
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Place a node whose key is not in the table, kicking resident keys if necessary
+     * If the kick chain is too long, the carried node goes to the stash
+     * Time Complexity: O(k) expected
+     * @param carry the node to place, reset on success; on failure it holds the key that is left out
+     * @return whether the node is placed
+     */
+    bool place(Slot &carry) {
+        for (size_t kick = 0; kick < MAX_KICKS; kick++) {
+            if (placeDirect(carry)) return true;
+            uint64_t r = nextRandom();
+            Bucket &bucket = buckets[bucketIndex(hash(carry->first), (int) (r & 1))];
+            Slot &victim = bucket.slots[(r >> 1) % SLOTS];
+            Slot evicted(std::move(victim));
+            victim.reset();
+            victim.emplace(std::move(*carry));
+            carry.reset();
+            carry.emplace(std::move(*evicted));
+        }
+        if (stashCount < STASH_SIZE) {
+            for (auto &slot : stash) {
+                if (!slot) {
+                    slot.emplace(std::move(*carry));
+                    carry.reset();
+                    stashCount++;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Rebuild the table with bucketSize buckets and a new seed
+     * If some key can not be placed, retry with a new seed and more buckets
+     * Time Complexity: O(nk) expected
+     * @param bucketSize the number of buckets, a prime in HashPrime
+     * @param pending a node not yet in the table, inserted along with the others
+     */
+    void rebuild(size_t bucketSize, Slot pending = std::nullopt) {
+        std::vector<Slot> nodes;
+        nodes.reserve(tableSize + 1);
+        for (auto &bucket : buckets) {
+            for (auto &slot : bucket.slots) {
+                if (slot) nodes.emplace_back(std::move(slot));
+            }
+        }
+        for (auto &slot : stash) {
+            if (slot) nodes.emplace_back(std::move(slot));
+        }
+        if (pending) nodes.emplace_back(std::move(pending));
+
+        for (int attempt = 0;; attempt++) {
+            // after a few failures with the same size, grow the table
+            if (attempt > 0 && attempt % 4 == 0) bucketSize = nextBucketSize(bucketSize);
+            CuckooTableData newBuckets(bucketSize);
+            std::vector<Slot> newStash(STASH_SIZE);
+            std::swap(buckets, newBuckets);
+            std::swap(stash, newStash);
+            stashCount = 0;
+            seed = HashFunction::mix64(seed + nextRandom());
+            size_t placed = 0;
+            for (; placed < nodes.size(); placed++) {
+                Slot carry(*nodes[placed]);
+                if (!place(carry)) break;
+            }
+            if (placed == nodes.size()) break;
+        }
+        tableSize = nodes.size();
+    }
+
+    static size_t nextBucketSize(size_t bucketSize) {
+        const size_t *end = HashPrime::g_a_sizes + HashPrime::num_distinct_sizes;
+        auto it = std::upper_bound(HashPrime::g_a_sizes, end, bucketSize);
+        if (it == end) throw std::range_error("[ERROR]: No suitable size found!");
+        return *it;
+    }
+
+    /**
+     * Find the minimum bucket size for the hashtable
+     * The minimum bucket size must satisfy all of the following requirements:
+     * - It is not less than (i.e. greater or equal to) the parameter bucketSize
+     * - The load factor with tableSize elements does not exceed maxLoadFactor
+     * - It is a (prime) number defined in HashPrime (hash_prime.hpp)
+     * - It is minimum if satisfying all other requirements
+     * Time Complexity: O(1)
+     * @throw std::range_error if no such bucket size can be found
+     * @param bucketSize lower bound of the new number of buckets
+     */
+    size_t findMinimumBucketSize(size_t bucketSize) const {
+        size_t needed = (size_t) std::ceil(static_cast<double>(tableSize) / (maxLoadFactor * SLOTS));
+        const size_t *end = HashPrime::g_a_sizes + HashPrime::num_distinct_sizes;
+        auto it = std::lower_bound(HashPrime::g_a_sizes, end, std::max(bucketSize, needed));
+        if (it == end) throw std::range_error("[ERROR]: No suitable size found!");
+        return *it;
+    }
+
+    /**
+     * Insert a key that is not in the table
+     * Time Complexity: Amortized O(k)
+     */
+    void insertNew(const Key &key, const Value &value) {
+        if ((double) (tableSize + 1) > maxLoadFactor * (double) (buckets.size() * SLOTS)) {
+            rebuild(findMinimumBucketSize(nextBucketSize(buckets.size())), Slot(std::in_place, key, value));
+            return;
+        }
+        Slot carry(std::in_place, key, value);
+        if (place(carry)) {
+            tableSize++;
+            return;
+        }
+        rebuild(buckets.size(), std::move(carry));
+    }
+
+    template<typename K>
+    bool eraseHashed(const K &key, size_t hashValue) {
+        size_t pos = locate(key, hashValue);
+        if (pos == NOT_FOUND) return false;
+        erase(Iterator(this, pos));
+        if (stashCount) drainStash();
+        return true;
+    }
+
+    /**
+     * Move keys from the stash back to their buckets if there is room
+     * Time Complexity: O(k)
+     */
+    void drainStash() {
+        for (auto &slot : stash) {
+            if (slot && placeDirect(slot)) stashCount--;
+        }
+    }
+
+public:
+    CuckooHashTable() :
+            buckets(DEFAULT_BUCKET_SIZE), stash(STASH_SIZE), maxLoadFactor(DEFAULT_LOAD_FACTOR),
+            seed(0x243f6a8885a308d3ull), kickState(0x13198a2e03707344ull), hash(Hash()), keyEqual(KeyEqual()) {}
+
+    explicit CuckooHashTable(size_t bucketSize) : CuckooHashTable() {
+        buckets = CuckooTableData(findMinimumBucketSize(bucketSize));
+    }
+
+    CuckooHashTable(const CuckooHashTable &that) = default;
+
+    CuckooHashTable(CuckooHashTable &&that) = default;
+
+    CuckooHashTable &operator=(CuckooHashTable that) {
+        std::swap(buckets, that.buckets);
+        std::swap(stash, that.stash);
+        std::swap(stashCount, that.stashCount);
+        std::swap(tableSize, that.tableSize);
+        std::swap(maxLoadFactor, that.maxLoadFactor);
+        std::swap(seed, that.seed);
+        std::swap(kickState, that.kickState);
+        std::swap(hash, that.hash);
+        std::swap(keyEqual, that.keyEqual);
+        return *this;
+    }
+
+    ~CuckooHashTable() = default;
+
+    Iterator begin() {
+        Iterator it(this, 0);
+        if (!slotAt(0)) it.increment();
+        return it;
+    }
+
+    Iterator end() {
+        return Iterator(this, endPos());
+    }
+
+    /**
+     * Find whether the key exists in the hashtable
+     * Time Complexity: O(k)
+     * @param key
+     * @return whether the key exists in the hashtable
+     */
+    bool contains(const Key &key) {
+        return locate(key, hash(key)) != NOT_FOUND;
+    }
+
+    /**
+     * Find the value in hashtable by key
+     * Time Complexity: O(k), at most two buckets and the stash are read
+     * @param key
+     * @return iterator of the value, or end() if the key doesn't exist
+     */
+    Iterator find(const Key &key) {
+        size_t pos = locate(key, hash(key));
+        return pos == NOT_FOUND ? end() : Iterator(this, pos);
+    }
+
+    /**
+     * Find the value in hashtable by key, reusing a hash value computed by hashCode
+     * The hash value can be shared by all tables with the same Hash
+     * Time Complexity: O(k), the key is not hashed again
+     * @param key
+     * @param hashValue hashCode(key)
+     * @return iterator of the value, or end() if the key doesn't exist
+     */
+    Iterator find(const Key &key, size_t hashValue) {
+        size_t pos = locate(key, hashValue);
+        return pos == NOT_FOUND ? end() : Iterator(this, pos);
+    }
+
+    /**
+     * Heterogeneous find, e.g. look up std::string keys by std::string_view or const char * without
+     * constructing a temporary Key
+     * Only available if both Hash and KeyEqual declare is_transparent
+     * Time Complexity: O(k)
+     * @param key
+     * @return iterator of the value, or end() if the key doesn't exist
+     */
+    template<typename K, typename H = Hash, typename E = KeyEqual, typename = Transparent<H, E>>
+    Iterator find(const K &key) {
+        return find(key, hash(key));
+    }
+
+    template<typename K, typename H = Hash, typename E = KeyEqual, typename = Transparent<H, E>>
+    Iterator find(const K &key, size_t hashValue) {
+        size_t pos = locate(key, hashValue);
+        return pos == NOT_FOUND ? end() : Iterator(this, pos);
+    }
+
+    template<typename K, typename H = Hash, typename E = KeyEqual, typename = Transparent<H, E>>
+    bool contains(const K &key) {
+        return locate(key, hash(key)) != NOT_FOUND;
+    }
+
+    bool contains(const Key &key, size_t hashValue) {
+        return locate(key, hashValue) != NOT_FOUND;
+    }
+
+    template<typename K, typename H = Hash, typename E = KeyEqual, typename = Transparent<H, E>>
+    bool contains(const K &key, size_t hashValue) {
+        return locate(key, hashValue) != NOT_FOUND;
+    }
+
+    /**
+     * Time Complexity: O(k)
+     * @param key
+     * @return the hash value of key, for the overloads taking a hash value
+     */
+    size_t hashCode(const Key &key) const {
+        return hash(key);
+    }
+
+    template<typename K, typename H = Hash, typename E = KeyEqual, typename = Transparent<H, E>>
+    size_t hashCode(const K &key) const {
+        return hash(key);
+    }
+
+    /**
+     * Insert value into the hashtable according to an iterator returned by find
+     * the function can be only be called if no other write actions are done to the hashtable after the find
+     * If the key already exists, overwrite its value
+     * If load factor exceeds maximum value, rehash the hashtable
+     * Time Complexity: Amortized O(k)
+     * @param it an iterator returned by find
+     * @param key
+     * @param value
+     * @return whether insertion took place (return false if the key already exists)
+     */
+    bool insert(const Iterator &it, const Key &key, const Value &value) {
+        if (it != end()) {
+            slotAt(it.pos)->second = value;
+            return false;
+        }
+        insertNew(key, value);
+        return true;
+    }
+
+    /**
+     * Insert <key, value> into the hashtable
+     * If the key already exists, overwrite its value
+     * If load factor exceeds maximum value, rehash the hashtable
+     * Time Complexity: Amortized O(k)
+     * @param key
+     * @param value
+     * @return whether insertion took place (return false if the key already exists)
+     */
+    bool insert(const Key &key, const Value &value) {
+        return insert(find(key), key, value);
+    }
+
+    /**
+     * Erase the key if it exists in the hashtable, otherwise, do nothing
+     * Keys in the stash are moved back to their buckets if a slot is freed
+     * Time Complexity: O(k)
+     * @param key
+     * @return whether the key exists
+     */
+    bool erase(const Key &key) {
+        return eraseHashed(key, hash(key));
+    }
+
+    bool erase(const Key &key, size_t hashValue) {
+        return eraseHashed(key, hashValue);
+    }
+
+    /**
+     * Heterogeneous erase, only available if both Hash and KeyEqual declare is_transparent
+     * Time Complexity: O(k)
+     * @param key
+     * @return whether the key exists
+     */
+    template<typename K, typename H = Hash, typename E = KeyEqual, typename = Transparent<H, E>>
+    bool erase(const K &key) {
+        return eraseHashed(key, hash(key));
+    }
+
+    template<typename K, typename H = Hash, typename E = KeyEqual, typename = Transparent<H, E>>
+    bool erase(const K &key, size_t hashValue) {
+        return eraseHashed(key, hashValue);
+    }
+
+    /**
+     * Erase the key at the input iterator
+     * If the input iterator is the end iterator, do nothing and return the input iterator directly
+     * Time Complexity: Amortized O(1)
+     * @param it
+     * @return the iterator after the input iterator before the erase
+     */
+    Iterator erase(const Iterator &it) {
+        if (it == end()) return it;
+        if (it.pos >= buckets.size() * SLOTS) stashCount--;
+        slotAt(it.pos).reset();
+        tableSize--;
+        Iterator next = it;
+        next.increment();
+        return next;
+    }
+
+    /**
+     * Get the reference of value by key in the hashtable
+     * If the key doesn't exist, create it first (use default constructor of Value)
+     * If load factor exceeds maximum value, rehash the hashtable
+     * Time Complexity: Amortized O(k)
+     * @param key
+     * @return reference of value
+     */
+    Value &operator[](const Key &key) {
+        size_t hashValue = hash(key);
+        size_t pos = locate(key, hashValue);
+        if (pos == NOT_FOUND) {
+            insertNew(key, Value());
+            pos = locate(key, hashValue);
+        }
+        return slotAt(pos)->second;
+    }
+
+    /**
+     * Rehash the hashtable according to the (hinted) number of buckets
+     * The bucket size after rehash need not be same as the parameter bucketSize
+     * Instead, findMinimumBucketSize is called to get the correct number
+     * Do nothing if the bucketSize doesn't change
+     * Time Complexity: O(nk) expected
+     * @param bucketSize lower bound of the new number of buckets
+     */
+    void rehash(size_t bucketSize) {
+        bucketSize = findMinimumBucketSize(bucketSize);
+        if (bucketSize == this->bucketSize()) return;
+        rebuild(bucketSize);
+    }
+
+    /**
+     * @return the number of elements in the hashtable
+     */
+    size_t size() const { return tableSize; }
+
+    /**
+     * @return the number of buckets in the hashtable
+     */
+    size_t bucketSize() const { return buckets.size(); }
+
+    /**
+     * @return the current load factor of the hashtable, relative to the number of slots
+     */
+    double loadFactor() const { return (double) tableSize / (double) (buckets.size() * SLOTS); }
+
+    /**
+     * @return the maximum load factor of the hashtable
+     */
+    double getMaxLoadFactor() const { return maxLoadFactor; }
+
+    /**
+     * Set the max load factor
+     * @throw std::range_error if the load factor is too small or not below 1
+     * @param loadFactor
+     */
+    void setMaxLoadFactor(double loadFactor) {
+        if (loadFactor <= 1e-9 || loadFactor >= 1) {
+            throw std::range_error("invalid load factor!");
+        }
+        maxLoadFactor = loadFactor;
+        rehash(bucketSize());
+    }
+};
+
+#endif //VE281P2_CUCKOO_HASHTABLE_HPP
@@ -0,0 +1,296 @@
+#ifndef VE281P2_HASH_FUNCTION_HPP
+#define VE281P2_HASH_FUNCTION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/**
+ * A family of hash functions that can be plugged into HashTable via its Hash template parameter
+ * - FastHash:     wyhash for strings and byte sequences, integer mixer for integral keys
+ * - IntegerHash:  a strong 64-bit finalizer for integral, enum and pointer keys
+ * - SipHash:      SipHash-2-4 keyed with a per-process random seed, resistant to hash flooding
+ * - StringHash, SipStringHash and StringEqual: transparent versions for heterogeneous string lookup
+ * std::hash is the identity on integers in libstdc++, which clusters sequential keys in the buckets;
+ * all hashers here avalanche every input bit into the output.
+ * The time complexity of functions are based on k, the length of the key
+ */
+namespace HashFunction {
+    namespace detail {
+        inline uint64_t read64(const uint8_t *p) {
+            uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        inline uint64_t read32(const uint8_t *p) {
+            uint32_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        // read 1 to 3 bytes
+        inline uint64_t read3(const uint8_t *p, size_t k) {
+            return (((uint64_t) p[0]) << 16) | (((uint64_t) p[k >> 1]) << 8) | p[k - 1];
+        }
+
+        inline uint64_t rotl(uint64_t x, int b) {
+            return (x << b) | (x >> (64 - b));
+        }
+
+        // 64x64 -> 128 bit multiplication, folded back to 64 bits
+        inline uint64_t mum(uint64_t a, uint64_t b) {
+            __uint128_t r = (__uint128_t) a * b;
+            return (uint64_t) r ^ (uint64_t) (r >> 64);
+        }
+
+        constexpr uint64_t WY_SECRET[4] = {
+                0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+        };
+
+        struct SipKey {
+            uint64_t k0, k1;
+        };
+
+        /**
+         * Random key shared by all SipHash instances of the process
+         * It is drawn once so that every table in the process hashes consistently
+         */
+        inline SipKey processKey() {
+            static const SipKey key = [] {
+                std::random_device rd;
+                uint64_t k0 = ((uint64_t) rd() << 32) | rd();
+                uint64_t k1 = ((uint64_t) rd() << 32) | rd();
+                return SipKey{k0, k1};
+            }();
+            return key;
+        }
+
+        template<typename Key>
+        constexpr bool isStringLike = std::is_convertible_v<const Key &, std::string_view>;
+
+        template<typename Key>
+        constexpr bool isWordLike = std::is_integral_v<Key> || std::is_enum_v<Key> || std::is_pointer_v<Key>;
+
+        template<typename Key>
+        constexpr bool isRawBytes = std::is_trivially_copyable_v<Key> && std::has_unique_object_representations_v<Key>;
+
+        template<typename Key>
+        uint64_t toWord(const Key &key) {
+            if constexpr (std::is_pointer_v<Key>) return (uint64_t) reinterpret_cast<uintptr_t>(key);
+            else return (uint64_t) key;
+        }
+    }
+
+    /**
+     * Finalizer of MurmurHash3, every input bit affects every output bit
+     * Time Complexity: O(1)
+     * @param x
+     * @return the mixed value
+     */
+    inline uint64_t mix64(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdull;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ull;
+        x ^= x >> 33;
+        return x;
+    }
+
+    /**
+     * wyhash (final version) of a byte sequence
+     * Time Complexity: O(k)
+     * @param data
+     * @param len
+     * @param seed
+     * @return the hash value
+     */
+    inline uint64_t wyhash(const void *data, size_t len, uint64_t seed = 0) {
+        using namespace detail;
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        const uint64_t *s = WY_SECRET;
+        seed ^= mum(seed ^ s[0], s[1]);
+        uint64_t a, b;
+        if (len <= 16) {
+            if (len >= 4) {
+                a = (read32(p) << 32) | read32(p + ((len >> 3) << 2));
+                b = (read32(p + len - 4) << 32) | read32(p + len - 4 - ((len >> 3) << 2));
+            } else if (len > 0) {
+                a = read3(p, len);
+                b = 0;
+            } else {
+                a = b = 0;
+            }
+        } else {
+            size_t i = len;
+            if (i > 48) {
+                uint64_t see1 = seed, see2 = seed;
+                do {
+                    seed = mum(read64(p) ^ s[1], read64(p + 8) ^ seed);
+                    see1 = mum(read64(p + 16) ^ s[2], read64(p + 24) ^ see1);
+                    see2 = mum(read64(p + 32) ^ s[3], read64(p + 40) ^ see2);
+                    p += 48;
+                    i -= 48;
+                } while (i > 48);
+                seed ^= see1 ^ see2;
+            }
+            while (i > 16) {
+                seed = mum(read64(p) ^ s[1], read64(p + 8) ^ seed);
+                i -= 16;
+                p += 16;
+            }
+            a = read64(p + i - 16);
+            b = read64(p + i - 8);
+        }
+        a ^= s[1];
+        b ^= seed;
+        __uint128_t r = (__uint128_t) a * b;
+        a = (uint64_t) r;
+        b = (uint64_t) (r >> 64);
+        return mum(a ^ s[0] ^ len, b ^ s[1]);
+    }
+
+    /**
+     * SipHash-2-4 of a byte sequence with a 128-bit key
+     * Time Complexity: O(k)
+     * @param data
+     * @param len
+     * @param k0 lower half of the key
+     * @param k1 upper half of the key
+     * @return the hash value
+     */
+    inline uint64_t siphash24(const void *data, size_t len, uint64_t k0, uint64_t k1) {
+        using namespace detail;
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        uint64_t v0 = 0x736f6d6570736575ull ^ k0;
+        uint64_t v1 = 0x646f72616e646f6dull ^ k1;
+        uint64_t v2 = 0x6c7967656e657261ull ^ k0;
+        uint64_t v3 = 0x7465646279746573ull ^ k1;
+        auto round = [&]() {
+            v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+            v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+            v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+            v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+        };
+        const uint8_t *end = p + (len & ~(size_t) 7);
+        for (; p != end; p += 8) {
+            uint64_t m = read64(p);
+            v3 ^= m;
+            round();
+            round();
+            v0 ^= m;
+        }
+        uint64_t last = ((uint64_t) len) << 56;
+        for (size_t i = 0; i < (len & 7); i++) {
+            last |= ((uint64_t) p[i]) << (8 * i);
+        }
+        v3 ^= last;
+        round();
+        round();
+        v0 ^= last;
+        v2 ^= 0xff;
+        round();
+        round();
+        round();
+        round();
+        return v0 ^ v1 ^ v2 ^ v3;
+    }
+
+    /**
+     * General purpose high-throughput hash
+     * Strings are hashed by wyhash, integers by mix64, other keys by their bytes or std::hash
+     * @tparam Key
+     */
+    template<typename Key>
+    struct FastHash {
+        size_t operator()(const Key &key) const {
+            if constexpr (detail::isStringLike<Key>) {
+                std::string_view view(key);
+                return wyhash(view.data(), view.size());
+            } else if constexpr (detail::isWordLike<Key>) {
+                return mix64(detail::toWord(key));
+            } else if constexpr (detail::isRawBytes<Key>) {
+                return wyhash(&key, sizeof(Key));
+            } else {
+                return mix64(std::hash<Key>()(key));
+            }
+        }
+    };
+
+    /**
+     * Strong integer mixer for integral, enum and pointer keys
+     * Sequential keys are spread over all buckets instead of clustering
+     * @tparam Key
+     */
+    template<typename Key>
+    struct IntegerHash {
+        static_assert(detail::isWordLike<Key>, "IntegerHash requires an integral, enum or pointer key");
+
+        size_t operator()(const Key &key) const {
+            return mix64(detail::toWord(key));
+        }
+    };
+
+    /**
+     * Seeded SipHash-2-4, use it when keys may be chosen by an adversary
+     * Default constructed instances share a random per-process key
+     * @tparam Key
+     */
+    template<typename Key>
+    struct SipHash {
+        uint64_t k0, k1;
+
+        SipHash() : k0(detail::processKey().k0), k1(detail::processKey().k1) {}
+
+        SipHash(uint64_t k0, uint64_t k1) : k0(k0), k1(k1) {}
+
+        size_t operator()(const Key &key) const {
+            if constexpr (detail::isStringLike<Key>) {
+                std::string_view view(key);
+                return siphash24(view.data(), view.size(), k0, k1);
+            } else if constexpr (detail::isWordLike<Key>) {
+                uint64_t word = detail::toWord(key);
+                return siphash24(&word, sizeof(word), k0, k1);
+            } else if constexpr (detail::isRawBytes<Key>) {
+                return siphash24(&key, sizeof(Key), k0, k1);
+            } else {
+                uint64_t word = std::hash<Key>()(key);
+                return siphash24(&word, sizeof(word), k0, k1);
+            }
+        }
+    };
+
+    /**
+     * Transparent string hash, any key convertible to std::string_view hashes to the same value
+     * Use it together with StringEqual to enable heterogeneous lookup in HashTable
+     */
+    struct StringHash : FastHash<std::string_view> {
+        using is_transparent = void;
+    };
+
+    /**
+     * Transparent seeded string hash, see SipHash
+     */
+    struct SipStringHash : SipHash<std::string_view> {
+        using is_transparent = void;
+        using SipHash<std::string_view>::SipHash;
+    };
+
+    /**
+     * Transparent string equality, compares any two keys convertible to std::string_view
+     */
+    struct StringEqual {
+        using is_transparent = void;
+
+        bool operator()(std::string_view a, std::string_view b) const {
+            return a == b;
+        }
+    };
+}
+
+#endif //VE281P2_HASH_FUNCTION_HPP
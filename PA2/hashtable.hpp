@@ -1,3 +1,6 @@
+#ifndef VE281P2_HASHTABLE_HPP
+#define VE281P2_HASHTABLE_HPP
+
 #include "hash_prime.hpp"
 
 #include <algorithm>
@@ -8,6 +11,7 @@
 #include <vector>
 #include <forward_list>
 #include <cmath>
+#include <type_traits>
 
 /**
  * The Hashtable class
@@ -159,6 +163,41 @@ protected:                                                                  // D
         return hash(key) % buckets.size();
     }
 
+    /**
+     * Enables the overloads taking a key of type K if both Hash and KeyEqual declare is_transparent
+     */
+    template<typename H, typename E>
+    using Transparent = std::void_t<typename H::is_transparent, typename E::is_transparent>;
+
+    /**
+     * Find the key in the bucket selected by a precomputed hash value
+     * Time Complexity: Amortized O(k)
+     * @param key a Key, or a key of a type comparable with Key by KeyEqual
+     * @param hashValue hash(key)
+     * @return iterator as returned by find
+     */
+    template<typename K>
+    Iterator findHashed(const K &key, size_t hashValue) {
+        size_t s = hashValue % buckets.size();
+        Iterator it(this, this->buckets.begin()+s, (this->buckets.begin()+s)->before_begin());
+        it.endFlag = false;
+        for(auto itt = it.bucketIt->begin(); itt!=it.bucketIt->end(); itt++, it.listItBefore++){
+            if(keyEqual(itt->first, key)) return it;
+        }
+        it.endFlag = true;
+        return it;
+    }
+
+    template<typename K>
+    bool eraseHashed(const K &key, size_t hashValue) {
+        auto it = findHashed(key, hashValue);
+        if(it.endFlag == true) return false;
+        it.bucketIt->erase_after(it.listItBefore);
+        tableSize--;
+        updateFirstBucketIt();
+        return true;
+    }
+
     /**
      * Find the minimum bucket size for the hashtable
      * The minimum bucket size must satisfy all of the following requirements:
@@ -267,14 +306,65 @@ public:
      */
     Iterator find(const Key &key) {
         // TODO: implement this function
-        size_t s = hashKey(key);
-        Iterator it(this, this->buckets.begin()+s, (this->buckets.begin()+s)->before_begin());
-        it.endFlag = false;
-        for(auto itt = it.bucketIt->begin(); itt!=it.bucketIt->end(); itt++, it.listItBefore++){
-            if(keyEqual(itt->first, key)) return it;
-        }
-        it.endFlag = true;
-        return it;
+        return findHashed(key, hash(key));
+    }
+
+    /**
+     * Find the value in hashtable by key, reusing a hash value computed by hashCode
+     * The hash value can be shared by all tables with the same Hash
+     * Time Complexity: Amortized O(k), the key is not hashed again
+     * @param key
+     * @param hashValue hashCode(key)
+     * @return iterator as returned by find(key)
+     */
+    Iterator find(const Key &key, size_t hashValue) {
+        return findHashed(key, hashValue);
+    }
+
+    /**
+     * Heterogeneous find, e.g. look up std::string keys by std::string_view or const char * without
+     * constructing a temporary Key
+     * Only available if both Hash and KeyEqual declare is_transparent
+     * Time Complexity: Amortized O(k)
+     * @param key
+     * @return iterator as returned by find(key)
+     */
+    template<typename K, typename H = Hash, typename E = KeyEqual, typename = Transparent<H, E>>
+    Iterator find(const K &key) {
+        return findHashed(key, hash(key));
+    }
+
+    template<typename K, typename H = Hash, typename E = KeyEqual, typename = Transparent<H, E>>
+    Iterator find(const K &key, size_t hashValue) {
+        return findHashed(key, hashValue);
+    }
+
+    template<typename K, typename H = Hash, typename E = KeyEqual, typename = Transparent<H, E>>
+    bool contains(const K &key) {
+        return find(key) != end();
+    }
+
+    bool contains(const Key &key, size_t hashValue) {
+        return find(key, hashValue) != end();
+    }
+
+    template<typename K, typename H = Hash, typename E = KeyEqual, typename = Transparent<H, E>>
+    bool contains(const K &key, size_t hashValue) {
+        return find(key, hashValue) != end();
+    }
+
+    /**
+     * Time Complexity: O(k)
+     * @param key
+     * @return the hash value of key before reduction to a bucket, for the overloads taking a hash value
+     */
+    size_t hashCode(const Key &key) const {
+        return hash(key);
+    }
+
+    template<typename K, typename H = Hash, typename E = KeyEqual, typename = Transparent<H, E>>
+    size_t hashCode(const K &key) const {
+        return hash(key);
     }
 
     /**
@@ -335,12 +425,27 @@ public:
      */
     bool erase(const Key &key) {
         // TODO: implement this function
-        auto it = find(key);
-        if(it.endFlag == true) return false;
-        it.bucketIt->erase_after(it.listItBefore);
-        tableSize--;
-        updateFirstBucketIt();
-        return true;
+        return eraseHashed(key, hash(key));
+    }
+
+    bool erase(const Key &key, size_t hashValue) {
+        return eraseHashed(key, hashValue);
+    }
+
+    /**
+     * Heterogeneous erase, only available if both Hash and KeyEqual declare is_transparent
+     * Time Complexity: Amortized O(k)
+     * @param key
+     * @return whether the key exists
+     */
+    template<typename K, typename H = Hash, typename E = KeyEqual, typename = Transparent<H, E>>
+    bool erase(const K &key) {
+        return eraseHashed(key, hash(key));
+    }
+
+    template<typename K, typename H = Hash, typename E = KeyEqual, typename = Transparent<H, E>>
+    bool erase(const K &key, size_t hashValue) {
+        return eraseHashed(key, hashValue);
     }
 
     /**
@@ -354,13 +459,17 @@ public:
     Iterator erase(const Iterator &it) {
         // TODO: implement this function
         if(it.endFlag == true) return it;
-        it.listItBefore = it.bucketIt->erase_after(it.listItBefore);
+        Iterator next = it;
+        if(it.bucketIt->erase_after(it.listItBefore) == it.bucketIt->end()){
+            // the erased node was the last one of its bucket, move on to the next non-empty bucket
+            next.listItBefore = it.bucketIt->before_begin();
+            while (++next.bucketIt != buckets.end() && next.bucketIt->empty());
+            if (next.bucketIt == buckets.end()) next.endFlag = true;
+            else next.listItBefore = next.bucketIt->before_begin();
+        }
         tableSize--;
         updateFirstBucketIt();
-        if(loadFactor() >= getMaxLoadFactor()){
-            rehash(bucketSize());
-        }
-        return it;
+        return next;
     }
 
     /**
@@ -440,3 +549,5 @@ public:
         rehash(bucketSize());
     }
 };
+
+#endif //VE281P2_HASHTABLE_HPP
@@ -0,0 +1,109 @@
+#ifndef VE281P2_SMALL_STRING_HPP
+#define VE281P2_SMALL_STRING_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/**
+ * An immutable string key with small string optimization
+ * Strings of at most INLINE_CAPACITY characters are stored inside the object without allocation,
+ * longer strings are stored in a heap buffer
+ * It converts to std::string_view, so it works with HashFunction::StringHash / StringEqual and
+ * can be looked up in a HashTable by std::string, std::string_view or const char *
+ */
+class SmallString {
+public:
+    static constexpr size_t INLINE_CAPACITY = 22;
+
+private:
+    size_t length = 0;
+    union {
+        char inlineData[INLINE_CAPACITY + 1];
+        char *heapData;
+    };
+
+    bool isInline() const { return length <= INLINE_CAPACITY; }
+
+    void assign(const char *data, size_t size) {
+        length = size;
+        char *dest = isInline() ? inlineData : (heapData = new char[size + 1]);
+        std::memcpy(dest, data, size);
+        dest[size] = '\0';
+    }
+
+    void steal(SmallString &that) {
+        length = that.length;
+        if (that.isInline()) {
+            std::memcpy(inlineData, that.inlineData, length + 1);
+        } else {
+            heapData = that.heapData;
+            that.length = 0;
+            that.inlineData[0] = '\0';
+        }
+    }
+
+    void release() {
+        if (!isInline()) delete[] heapData;
+        length = 0;
+        inlineData[0] = '\0';
+    }
+
+public:
+    SmallString() { inlineData[0] = '\0'; }
+
+    SmallString(std::string_view view) { assign(view.data(), view.size()); }
+
+    SmallString(const char *str) : SmallString(std::string_view(str)) {}
+
+    SmallString(const std::string &str) : SmallString(std::string_view(str)) {}
+
+    SmallString(const SmallString &that) { assign(that.data(), that.size()); }
+
+    SmallString(SmallString &&that) noexcept { steal(that); }
+
+    SmallString &operator=(SmallString that) {
+        release();
+        steal(that);
+        return *this;
+    }
+
+    ~SmallString() { release(); }
+
+    const char *data() const { return isInline() ? inlineData : heapData; }
+
+    const char *c_str() const { return data(); }
+
+    size_t size() const { return length; }
+
+    bool empty() const { return length == 0; }
+
+    operator std::string_view() const { return {data(), length}; }
+
+    std::string str() const { return {data(), length}; }
+
+    friend bool operator==(const SmallString &a, const SmallString &b) {
+        return std::string_view(a) == std::string_view(b);
+    }
+
+    friend bool operator!=(const SmallString &a, const SmallString &b) {
+        return !(a == b);
+    }
+
+    friend bool operator<(const SmallString &a, const SmallString &b) {
+        return std::string_view(a) < std::string_view(b);
+    }
+};
+
+namespace std {
+    template<>
+    struct hash<SmallString> {
+        size_t operator()(const SmallString &str) const {
+            return hash<string_view>()(str);
+        }
+    };
+}
+
+#endif //VE281P2_SMALL_STRING_HPP
@@ -0,0 +1,331 @@
+#include "bucket_kdtree.hpp"
+#include "concurrent_kdtree.hpp"
+#include "kdtree.hpp"
+#include "kdtree_kernel.hpp"
+#include "static_kdtree.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Nearest neighbor and range queries on KDTree against brute force, and batched queries on StaticKDTree
+// Every answer is checked against brute force on the same queries, or against another engine that was, and the
+// bench exits with 1 if any differs
+// Usage: ./bench [number of queries]
+// Build with -O3 (and optionally -march=native) so that the kernels in kdtree_kernel.hpp are vectorized
+
+typedef tuple<double, double, double> Point;
+
+template<typename Func>
+double timeMs(Func &&func) {
+    auto start = chrono::steady_clock::now();
+    func();
+    auto end = chrono::steady_clock::now();
+    return (double) chrono::duration_cast<chrono::microseconds>(end - start).count() / 1000.0;
+}
+
+size_t wrong = 0;   // answers that differ from brute force
+
+void check(size_t mismatches, const char *what) {
+    if (mismatches) printf("  %zu %s answers differ from brute force\n", mismatches, what);
+    wrong += mismatches;
+}
+
+double distance(const Point &a, const Point &b) {
+    return KDTreeMetric::distance<KDTreeMetric::L2>(a, b);
+}
+
+// the distance of the nearest point to target, by a full scan
+double bruteNearest(const vector<pair<Point, int>> &points, const Point &target) {
+    double best = numeric_limits<double>::infinity();
+    for (auto &point : points) best = min(best, distance(target, point.first));
+    return best;
+}
+
+int main(int argc, char **argv) {
+    size_t queries = argc > 1 ? stoul(argv[1]) : 1000;
+    const size_t k = 8;
+    mt19937_64 rng(281);
+    uniform_real_distribution<double> uniform(0, 1);
+    auto randomPoint = [&] { return Point(uniform(rng), uniform(rng), uniform(rng)); };
+
+    printf("%10s %14s %14s %14s %10s\n", "n", "build ms", "knn us/query", "brute us/query", "speedup");
+    for (size_t n = 1000; n <= 1000000; n *= 10) {
+        vector<pair<Point, int>> points(n);
+        for (size_t i = 0; i < n; i++) points[i] = {randomPoint(), (int) i};
+        vector<Point> targets(queries);
+        for (auto &target : targets) target = randomPoint();
+
+        KDTree<Point, int> *tree = nullptr;
+        double buildMs = timeMs([&] { tree = new KDTree<Point, int>(points); });
+
+        vector<vector<KDTree<Point, int>::Data *>> found(queries);
+        double treeMs = timeMs([&] {
+            for (size_t q = 0; q < queries; q++) found[q] = tree->knn(targets[q], k);
+        });
+
+        // brute force: keep the k best in a bounded max-heap
+        size_t bruteQueries = min(queries, (size_t) (2e8 / (double) n) + 1);
+        vector<vector<double>> expected(bruteQueries);
+        double bruteMs = timeMs([&] {
+            for (size_t q = 0; q < bruteQueries; q++) {
+                priority_queue<double> heap;
+                for (auto &point : points) {
+                    double dist = distance(targets[q], point.first);
+                    if (heap.size() < k) heap.push(dist);
+                    else if (dist < heap.top()) {
+                        heap.pop();
+                        heap.push(dist);
+                    }
+                }
+                for (expected[q].resize(heap.size()); !heap.empty(); heap.pop()) expected[q][heap.size() - 1] = heap.top();
+            }
+        });
+
+        // the distances, not the points, so that ties may be broken either way
+        size_t mismatches = 0;
+        for (size_t q = 0; q < bruteQueries; q++) {
+            bool same = found[q].size() == expected[q].size();
+            for (size_t i = 0; same && i < expected[q].size(); i++) {
+                same = distance(targets[q], found[q][i]->first) == expected[q][i];
+            }
+            mismatches += !same;
+        }
+
+        double treeUs = 1000.0 * treeMs / (double) queries;
+        double bruteUs = 1000.0 * bruteMs / (double) bruteQueries;
+        printf("%10zu %14.2f %14.3f %14.3f %9.1fx\n", n, buildMs, treeUs, bruteUs, bruteUs / treeUs);
+        check(mismatches, "knn");
+        delete tree;
+    }
+
+    // boxes with side 0.1 over one million points
+    size_t n = 1000000;
+    vector<pair<Point, int>> points(n);
+    for (size_t i = 0; i < n; i++) points[i] = {randomPoint(), (int) i};
+    double serialMs = timeMs([&] { KDTree<Point, int> serial(points); });
+    double parallelMs = timeMs([&] { KDTree<Point, int> parallel(points, 0); });
+    printf("\nbuild over %zu points: serial %.2f ms, parallel (%u threads) %.2f ms\n", n, serialMs,
+           max(1u, thread::hardware_concurrency()), parallelMs);
+    KDTree<Point, int> tree(points);
+    KDTree<Point, int> *copy = nullptr;
+    double copyMs = timeMs([&] { copy = new KDTree<Point, int>(tree); });
+    double destroyMs = timeMs([&] { delete copy; });
+    printf("copy %.2f ms, destroy %.2f ms\n", copyMs, destroyMs);
+    vector<pair<Point, Point>> boxes(queries);
+    for (auto &box : boxes) {
+        Point lo = randomPoint();
+        box = {lo, Point(get<0>(lo) + 0.1, get<1>(lo) + 0.1, get<2>(lo) + 0.1)};
+    }
+    vector<size_t> counted(queries), visited(queries);
+    double countMs = timeMs([&] {
+        for (size_t q = 0; q < queries; q++) counted[q] = tree.rangeCount(boxes[q].first, boxes[q].second);
+    });
+    double queryMs = timeMs([&] {
+        for (size_t q = 0; q < queries; q++) {
+            tree.rangeQuery(boxes[q].first, boxes[q].second, [&](auto &) { visited[q]++; });
+        }
+    });
+    size_t scanQueries = min(queries, (size_t) 20);
+    vector<size_t> scanned(scanQueries);
+    double scanMs = timeMs([&] {
+        for (size_t q = 0; q < scanQueries; q++) {
+            for (auto &point : points) {
+                const Point &lo = boxes[q].first, &hi = boxes[q].second;
+                scanned[q] += get<0>(lo) <= get<0>(point.first) && get<0>(point.first) <= get<0>(hi) &&
+                              get<1>(lo) <= get<1>(point.first) && get<1>(point.first) <= get<1>(hi) &&
+                              get<2>(lo) <= get<2>(point.first) && get<2>(point.first) <= get<2>(hi);
+            }
+        }
+    });
+    printf("range over %zu points: rangeCount %.3f us/box, rangeQuery %.3f us/box, full scan %.3f us/box\n",
+           n, 1000.0 * countMs / (double) queries, 1000.0 * queryMs / (double) queries,
+           1000.0 * scanMs / (double) scanQueries);
+    // rangeQuery against rangeCount on every box, and both against the scan where there is one
+    size_t rangeMismatches = 0;
+    for (size_t q = 0; q < queries; q++) {
+        rangeMismatches += counted[q] != visited[q] || (q < scanQueries && counted[q] != scanned[q]);
+    }
+    check(rangeMismatches, "range");
+
+    // sorted insertions degenerate a plain tree into a list, scapegoat rebalancing keeps it O(log n) deep
+    size_t sortedN = 20000;
+    double plainMs = timeMs([&] {
+        KDTree<Point, int> plain;
+        for (size_t i = 0; i < sortedN; i++) plain.insert(Point((double) i, (double) i, (double) i), (int) i);
+        for (size_t i = 0; i < sortedN; i += 7) plain.find(Point((double) i, (double) i, (double) i));
+    });
+    double balancedMs = timeMs([&] {
+        KDTree<Point, int> balanced;
+        balanced.setBalanceFactor(0.7);
+        for (size_t i = 0; i < sortedN; i++) balanced.insert(Point((double) i, (double) i, (double) i), (int) i);
+        for (size_t i = 0; i < sortedN; i += 7) balanced.find(Point((double) i, (double) i, (double) i));
+    });
+    printf("%zu sorted insertions and lookups: plain %.2f ms, rebalanced %.2f ms\n", sortedN, plainMs, balancedMs);
+
+    // one query at a time against the batch engine, on the same static tree
+    StaticKDTree<Point, int> staticTree(points);
+    vector<Point> targets(200 * queries);
+    for (auto &target : targets) target = randomPoint();
+    vector<size_t> single(targets.size()), batched;
+    double singleMs = timeMs([&] {
+        for (size_t q = 0; q < targets.size(); q++) single[q] = staticTree.nearest(targets[q]);
+    });
+    double batchMs = timeMs([&] { batched = staticTree.nearestBatch(targets); });
+    printf("static nearest over %zu points, %zu queries: one by one %.3f us/query, batched %.3f us/query\n",
+           n, targets.size(), 1000.0 * singleMs / (double) targets.size(), 1000.0 * batchMs / (double) targets.size());
+    // a full scan per query is too slow for all of them: the first ones against brute force, and the nearest
+    // distances of the rest against those of the single queries, which every later engine is compared to
+    vector<double> nearestDist(targets.size());
+    for (size_t q = 0; q < targets.size(); q++) nearestDist[q] = distance(targets[q], staticTree.key(single[q]));
+    size_t staticMismatches = 0;
+    for (size_t q = 0; q < targets.size(); q++) {
+        staticMismatches += distance(targets[q], staticTree.key(batched[q])) != nearestDist[q] ||
+                            (q < scanQueries && nearestDist[q] != bruteNearest(points, targets[q]));
+    }
+    check(staticMismatches, "static nearest");
+
+    // start-up from a saved index instead of building from the points
+    string indexPath = "bench_index.kdt";
+    double buildMs = timeMs([&] { StaticKDTree<Point, int> rebuilt(points); });
+    double saveMs = timeMs([&] { staticTree.save(indexPath); });
+    vector<size_t> mappedFound;
+    double loadMs = timeMs([&] {
+        auto mapped = StaticKDTree<Point, int>::load(indexPath);
+        mappedFound = mapped.nearestBatch(targets);
+    });
+    remove(indexPath.c_str());
+    printf("static index over %zu points: build %.2f ms, save %.2f ms, load and answer all queries %.2f ms\n",
+           n, buildMs, saveMs, loadMs);
+    // the loaded tree has the same layout, so the same node indices
+    check(mappedFound == batched ? 0 : targets.size(), "loaded static nearest");
+
+    // the same queries on bucketed trees, against the pointer tree
+    // the values are the indices into points
+    vector<int> pointerFound(targets.size());
+    double pointerMs = timeMs([&] {
+        for (size_t q = 0; q < targets.size(); q++) pointerFound[q] = tree.nearest(targets[q])->second;
+    });
+    printf("nearest over %zu points: KDTree %.3f us/query\n", n, 1000.0 * pointerMs / (double) targets.size());
+    size_t pointerMismatches = 0;
+    for (size_t q = 0; q < targets.size(); q++) {
+        pointerMismatches += distance(targets[q], points[pointerFound[q]].first) != nearestDist[q];
+    }
+    check(pointerMismatches, "KDTree nearest");
+    for (size_t bucketSize : {8, 32, 64}) {
+        BucketKDTree<Point, int> bucketTree(points, bucketSize);
+        vector<int> bucketFound(targets.size());
+        vector<size_t> bucketCounted(queries);
+        double bucketMs = timeMs([&] {
+            for (size_t q = 0; q < targets.size(); q++) bucketFound[q] = bucketTree.nearest(targets[q])->second;
+        });
+        double bucketCountMs = timeMs([&] {
+            for (size_t q = 0; q < queries; q++) bucketCounted[q] = bucketTree.rangeCount(boxes[q].first, boxes[q].second);
+        });
+        printf("BucketKDTree B = %zu: nearest %.3f us/query, rangeCount %.3f us/box\n", bucketSize,
+               1000.0 * bucketMs / (double) targets.size(), 1000.0 * bucketCountMs / (double) queries);
+        size_t bucketMismatches = 0;
+        for (size_t q = 0; q < targets.size(); q++) {
+            bucketMismatches += distance(targets[q], points[bucketFound[q]].first) != nearestDist[q];
+        }
+        for (size_t q = 0; q < queries; q++) bucketMismatches += bucketCounted[q] != counted[q];
+        check(bucketMismatches, "BucketKDTree");
+    }
+
+    // lookups from several threads while one writer keeps updating: snapshots against a reader-writer lock
+    vector<pair<Point, int>> sample(points.begin(), points.begin() + 100000);
+    unsigned maxThreads = max(2u, thread::hardware_concurrency());
+    for (unsigned readers = 1; readers <= maxThreads; readers *= 2) {
+        ConcurrentKDTree<Point, int> concurrent(sample);
+        KDTree<Point, int> locked(sample);
+        shared_mutex lock;
+        // every key of sample stays in the trees, with its value or the value + 1 written by update
+        size_t missed = 0;
+        auto measure = [&](auto lookup, auto update) {
+            atomic<bool> stop{false};
+            atomic<size_t> lookups{0}, misses{0};
+            vector<thread> threads;
+            for (unsigned r = 0; r < readers; r++) {
+                threads.emplace_back([&, r] {
+                    size_t done = 0, miss = 0;
+                    for (size_t i = r; !stop; i += readers, done++) {
+                        auto &item = sample[i % sample.size()];
+                        int value = lookup(item.first);
+                        miss += value != item.second && value != item.second + 1;
+                    }
+                    lookups += done;
+                    misses += miss;
+                });
+            }
+            auto start = chrono::steady_clock::now();
+            for (size_t i = 0; chrono::steady_clock::now() - start < chrono::milliseconds(300); i++) {
+                update(sample[i % sample.size()]);
+                this_thread::sleep_for(chrono::microseconds(50));
+            }
+            stop = true;
+            for (auto &worker : threads) worker.join();
+            missed += misses;
+            return (double) lookups / 300.0;
+        };
+        // lookups return the value, or -1 if the key is missing
+        double snapshotRate = measure([&](const Point &key) {
+            auto snapshot = concurrent.snapshot();
+            const int *found = snapshot.find(key);
+            return found ? *found : -1;
+        }, [&](const pair<Point, int> &item) { concurrent.insert(item.first, item.second + 1); });
+        double lockRate = measure([&](const Point &key) {
+            shared_lock<shared_mutex> guard(lock);
+            auto found = locked.find(key);
+            return found != locked.end() ? found->second : -1;
+        }, [&](const pair<Point, int> &item) {
+            unique_lock<shared_mutex> guard(lock);
+            locked.insert(item.first, item.second + 1);
+        });
+        printf("%u readers, one writer: snapshots %.0f lookups/ms, shared_mutex %.0f lookups/ms\n", readers,
+               snapshotRate, lockRate);
+        check(missed, "concurrent lookup");
+    }
+
+    // leaf-sized brute force scans of cache resident points: per-dimension tuple access against the packed kernel
+    const size_t bucket = 32, resident = 4096;
+    vector<KDTreeKernel::Packed<Point>> packed(resident);
+    for (size_t i = 0; i < resident; i++) packed[i] = KDTreeKernel::pack(points[i].first);
+    size_t scalarSum = 0, kernelSum = 0;
+    double scalarMs = timeMs([&] {
+        for (auto &target : targets) {
+            for (size_t first = 0; first < resident; first += bucket) {
+                double bestDist = numeric_limits<double>::infinity();
+                size_t best = 0;
+                for (size_t i = first; i < first + bucket; i++) {
+                    double dist = KDTreeMetric::distance<KDTreeMetric::L2>(target, points[i].first);
+                    if (dist < bestDist) bestDist = dist, best = i - first;
+                }
+                scalarSum += best;
+            }
+        }
+    });
+    double kernelMs = timeMs([&] {
+        for (auto &target : targets) {
+            auto query = KDTreeKernel::pack(target);
+            for (size_t first = 0; first < resident; first += bucket) {
+                double bestDist = numeric_limits<double>::infinity();
+                kernelSum += KDTreeKernel::nearest<KDTreeMetric::L2>(packed.data() + first, bucket, query, bestDist);
+            }
+        }
+    });
+    double scans = (double) (targets.size() * (resident / bucket));
+    printf("nearest in a bucket of %zu points: tuple %.1f ns/scan, packed kernel %.1f ns/scan\n", bucket,
+           1e6 * scalarMs / scans, 1e6 * kernelMs / scans);
+    check(scalarSum != kernelSum, "packed kernel");
+
+    if (wrong) {
+        printf("%zu wrong answers\n", wrong);
+        return 1;
+    }
+    return 0;
+}
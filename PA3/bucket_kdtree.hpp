@@ -0,0 +1,410 @@
+#ifndef VE281P3_BUCKET_KDTREE_HPP
+#define VE281P3_BUCKET_KDTREE_HPP
+
+#include <tuple>
+#include <vector>
+#include <variant>
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "kdtree_kernel.hpp"
+#include "kdtree_metric.hpp"
+
+/**
+ * An abstract template base of the BucketKDTree class
+ */
+template<typename...>
+class BucketKDTree;
+
+/**
+ * A read-only KDTree bulk loaded from a vector, whose leaves are buckets of up to B key-value pairs
+ * All pairs are stored contiguously, the pairs of every subtree form one range, so a query scans a bucket
+ * with a tight loop (a vectorized kernel from kdtree_kernel.hpp if the key is packable) instead of
+ * following one pointer per pair
+ * Internal nodes only keep the splitting value and dimension; they are stored in preorder,
+ * the left child of a node is the next node and the right child is referenced by index
+ * Pairs in the left subtree are not greater than the splitting value on its dimension, pairs in the
+ * right subtree are not less, so a key equal to the splitting value may be on either side
+ * Iteration visits the pairs bucket by bucket
+ * The time complexity of functions are based on n, k and B
+ * n is the size of the KDTree
+ * k is the number of dimensions
+ * B is the bucket size
+ * @typedef Key         key type
+ * @typedef Value       value type
+ * @typedef Data        key-value pair
+ * @static  KeySize     k (number of dimensions)
+ */
+template<typename ValueType, typename... KeyTypes>
+class BucketKDTree<std::tuple<KeyTypes...>, ValueType> {
+public:
+    typedef std::tuple<KeyTypes...> Key;
+    typedef ValueType Value;
+    typedef std::pair<const Key, Value> Data;
+    typedef typename std::vector<Data>::iterator Iterator;
+    static inline constexpr size_t KeySize = std::tuple_size<Key>::value;
+    static inline constexpr size_t DEFAULT_BUCKET_SIZE = 32;
+    static inline constexpr bool Packed = KDTreeKernel::isPackable<Key>;
+    static_assert(KeySize > 0, "Can not construct BucketKDTree with zero dimension");
+
+protected:
+    struct Node {
+        std::variant<KeyTypes...> split;    // splitting value, its index is the splitting dimension
+        size_t right = 0;                   // index of the right child, 0 for a leaf
+        size_t first = 0, last = 0;         // the pairs of the subtree are items[first, last)
+
+        bool isLeaf() const { return right == 0; }
+    };
+
+    typedef std::conditional_t<Packed, KDTreeKernel::Packed<Key>, Key> ScanKey;
+
+    std::vector<Node> nodes;                // in preorder, nodes[0] is the root
+    std::vector<Data> items;                // pairs in bucket order
+    std::vector<ScanKey> scanKeys;          // packed copy of the keys of items, if Packed
+    size_t bucketSize = DEFAULT_BUCKET_SIZE;
+
+    template<size_t DIM, typename Compare>
+    static bool compareKey(const Key &a, const Key &b, Compare compare = Compare()) {
+        if (std::get<DIM>(a) != std::get<DIM>(b)) {
+            return compare(std::get<DIM>(a), std::get<DIM>(b));
+        }
+        return compare(a, b);
+    }
+
+    template<size_t DIM>
+    static bool sortComp(const std::pair<Key, Value> &a, const std::pair<Key, Value> &b) {
+        return compareKey<DIM, std::less<>>(a.first, b.first);
+    }
+
+    static bool uniqueComp(const std::pair<Key, Value> &a, const std::pair<Key, Value> &b) {
+        return a.first == b.first;
+    }
+
+    const Key &keyAt(size_t item) const { return items[item].first; }
+
+    /**
+     * Build the subtree of v[first, last), splitting at the median until a range fits in a bucket
+     * Time Complexity: O(kn log(n / B))
+     * @tparam DIM splitting dimension of the subtree
+     */
+    template<size_t DIM>
+    void build(size_t first, size_t last, std::vector<std::pair<Key, Value>> &v) {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        size_t index = nodes.size();
+        nodes.emplace_back();
+        nodes[index].first = first;
+        nodes[index].last = last;
+        if (last - first <= bucketSize) return;
+        size_t mid = first + (last - first) / 2;
+        std::nth_element(v.begin() + first, v.begin() + mid, v.begin() + last, sortComp<DIM>);
+        nodes[index].split.template emplace<DIM>(std::get<DIM>(v[mid].first));
+        build<DIM_NEXT>(first, mid, v);
+        nodes[index].right = nodes.size();
+        build<DIM_NEXT>(mid, last, v);
+    }
+
+    template<size_t DIM>
+    const auto &split(const Node &node) const {
+        return *std::get_if<DIM>(&node.split);
+    }
+
+    /**
+     * Time Complexity: O(k log(n / B) + kB) if keys rarely tie with splitting values
+     * @tparam DIM splitting dimension of node
+     * @return the item index with key, or items.size() if not found
+     */
+    template<size_t DIM>
+    size_t find(const Key &key, size_t index) const {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        const Node &node = nodes[index];
+        if (node.isLeaf()) {
+            for (size_t i = node.first; i < node.last; i++) {
+                if (keyAt(i) == key) return i;
+            }
+            return items.size();
+        }
+        const auto &value = split<DIM>(node);
+        if (std::get<DIM>(key) < value) return find<DIM_NEXT>(key, index + 1);
+        if (value < std::get<DIM>(key)) return find<DIM_NEXT>(key, node.right);
+        // equal to the splitting value, the key may be on either side
+        size_t result = find<DIM_NEXT>(key, index + 1);
+        return result != items.size() ? result : find<DIM_NEXT>(key, node.right);
+    }
+
+    template<size_t DIM_CMP, typename Compare>
+    size_t compareItem(size_t a, size_t b) const {
+        if (a == items.size()) return b;
+        if (b == items.size()) return a;
+        return compareKey<DIM_CMP, Compare>(keyAt(a), keyAt(b)) ? a : b;
+    }
+
+    /**
+     * Find the minimum item on a dimension
+     * The left subtree of a node splitting on DIM_CMP holds the minimum
+     * Time Complexity: O((n / B)^(1-1/k) B)
+     * @tparam DIM_CMP comparison dimension
+     * @tparam DIM splitting dimension of node
+     */
+    template<size_t DIM_CMP, size_t DIM>
+    size_t findMin(size_t index) const {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        const Node &node = nodes[index];
+        if (node.isLeaf()) {
+            size_t min = items.size();
+            for (size_t i = node.first; i < node.last; i++) min = compareItem<DIM_CMP, std::less<>>(i, min);
+            return min;
+        }
+        size_t min = findMin<DIM_CMP, DIM_NEXT>(index + 1);
+        if (DIM_CMP != DIM) {
+            min = compareItem<DIM_CMP, std::less<>>(min, findMin<DIM_CMP, DIM_NEXT>(node.right));
+        }
+        return min;
+    }
+
+    /**
+     * Find the maximum item on a dimension
+     * The right subtree of a node splitting on DIM_CMP holds the maximum
+     * Time Complexity: O((n / B)^(1-1/k) B)
+     * @tparam DIM_CMP comparison dimension
+     * @tparam DIM splitting dimension of node
+     */
+    template<size_t DIM_CMP, size_t DIM>
+    size_t findMax(size_t index) const {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        const Node &node = nodes[index];
+        if (node.isLeaf()) {
+            size_t max = items.size();
+            for (size_t i = node.first; i < node.last; i++) max = compareItem<DIM_CMP, std::greater<>>(i, max);
+            return max;
+        }
+        size_t max = findMax<DIM_CMP, DIM_NEXT>(node.right);
+        if (DIM_CMP != DIM) {
+            max = compareItem<DIM_CMP, std::greater<>>(max, findMax<DIM_CMP, DIM_NEXT>(index + 1));
+        }
+        return max;
+    }
+
+    template<size_t DIM>
+    size_t findMinDynamic(size_t dim) const {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (dim >= KeySize) {
+            dim %= KeySize;
+        }
+        if (dim == DIM) return findMin<DIM, 0>(0);
+        return findMinDynamic<DIM_NEXT>(dim);
+    }
+
+    template<size_t DIM>
+    size_t findMaxDynamic(size_t dim) const {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (dim >= KeySize) {
+            dim %= KeySize;
+        }
+        if (dim == DIM) return findMax<DIM, 0>(0);
+        return findMaxDynamic<DIM_NEXT>(dim);
+    }
+
+    /**
+     * Scan the bucket items[first, last) for a key closer than bestDist
+     */
+    template<typename Metric>
+    void scanNearest(const ScanKey &query, size_t first, size_t last, size_t &best, double &bestDist) const {
+        if constexpr (Packed) {
+            size_t found = KDTreeKernel::nearest<Metric>(scanKeys.data() + first, last - first, query, bestDist);
+            if (found != last - first) best = first + found;
+        } else {
+            for (size_t i = first; i < last; i++) {
+                double dist = KDTreeMetric::distance<Metric>(query, keyAt(i));
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = i;
+                }
+            }
+        }
+    }
+
+    /**
+     * Branch-and-bound nearest neighbor search
+     * Time Complexity: O(log(n / B) + kB) expected for well distributed points
+     * @tparam DIM splitting dimension of node
+     */
+    template<size_t DIM, typename Metric>
+    void nearest(const Key &key, const ScanKey &query, size_t index, size_t &best, double &bestDist) const {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        const Node &node = nodes[index];
+        if (node.isLeaf()) {
+            scanNearest<Metric>(query, node.first, node.last, best, bestDist);
+            return;
+        }
+        double diff = (double) std::get<DIM>(key) - (double) split<DIM>(node);
+        size_t nearSide = diff < 0 ? index + 1 : node.right;
+        size_t farSide = diff < 0 ? node.right : index + 1;
+        nearest<DIM_NEXT, Metric>(key, query, nearSide, best, bestDist);
+        if (Metric::term(diff) < bestDist) nearest<DIM_NEXT, Metric>(key, query, farSide, best, bestDist);
+    }
+
+    template<size_t... DIMS>
+    static bool inBox(const Key &key, const Key &lo, const Key &hi, std::index_sequence<DIMS...>) {
+        return ((std::get<DIMS>(lo) <= std::get<DIMS>(key) && std::get<DIMS>(key) <= std::get<DIMS>(hi)) && ...);
+    }
+
+    /**
+     * Visit all items with lo <= key <= hi on every dimension
+     * Time Complexity: O((n / B)^(1-1/k) B + m), m is the number of reported items
+     * @tparam DIM splitting dimension of node
+     * @param visitor called with the index of every item in the box
+     */
+    template<size_t DIM, typename Visitor>
+    void rangeQuery(size_t index, const Key &lo, const Key &hi, Visitor &visitor) const {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        const Node &node = nodes[index];
+        if (node.isLeaf()) {
+            for (size_t i = node.first; i < node.last; i++) {
+                if (inBox(keyAt(i), lo, hi, std::index_sequence_for<KeyTypes...>())) visitor(i);
+            }
+            return;
+        }
+        const auto &value = split<DIM>(node);
+        if (!(value < std::get<DIM>(lo))) rangeQuery<DIM_NEXT>(index + 1, lo, hi, visitor);
+        if (!(std::get<DIM>(hi) < value)) rangeQuery<DIM_NEXT>(node.right, lo, hi, visitor);
+    }
+
+    /**
+     * Count the items with lo <= key <= hi on every dimension, a bucket is counted with one kernel call
+     * Time Complexity: O((n / B)^(1-1/k) kB)
+     * @tparam DIM splitting dimension of node
+     */
+    template<size_t DIM>
+    size_t rangeCount(size_t index, const Key &lo, const Key &hi) const {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        const Node &node = nodes[index];
+        if (node.isLeaf()) {
+            if constexpr (Packed) {
+                return KDTreeKernel::countInBox(scanKeys.data() + node.first, node.last - node.first,
+                                                KDTreeKernel::pack(lo), KDTreeKernel::pack(hi));
+            } else {
+                size_t count = 0;
+                for (size_t i = node.first; i < node.last; i++) {
+                    count += inBox(keyAt(i), lo, hi, std::index_sequence_for<KeyTypes...>());
+                }
+                return count;
+            }
+        }
+        const auto &value = split<DIM>(node);
+        size_t count = 0;
+        if (!(value < std::get<DIM>(lo))) count += rangeCount<DIM_NEXT>(index + 1, lo, hi);
+        if (!(std::get<DIM>(hi) < value)) count += rangeCount<DIM_NEXT>(node.right, lo, hi);
+        return count;
+    }
+
+    Iterator at(size_t item) {
+        return items.begin() + (std::ptrdiff_t) item;
+    }
+
+public:
+    BucketKDTree() = default;
+
+    /**
+     * Same semantics as the KDTree constructor: if a key appears more than once, the last value is kept
+     * Time complexity: O(kn log(n / B))
+     * @param v we pass by value here because v need to be modified
+     * @param bucketSize B, the maximum number of pairs in a leaf
+     * @throw std::invalid_argument if bucketSize is 0
+     */
+    explicit BucketKDTree(std::vector<std::pair<Key, Value>> v, size_t bucketSize = DEFAULT_BUCKET_SIZE)
+            : bucketSize(bucketSize) {
+        if (bucketSize == 0) throw std::invalid_argument("bucket size must be positive!");
+        std::stable_sort(v.begin(), v.end(), sortComp<0>);
+        auto ip = std::unique(v.rbegin(), v.rend(), uniqueComp);
+        v.erase(v.begin(), ip.base());
+        if (v.empty()) return;
+        nodes.reserve(2 * (v.size() / std::max<size_t>(1, bucketSize / 2)) + 1);
+        build<0>(0, v.size(), v);
+        items.reserve(v.size());
+        for (auto &pair : v) items.emplace_back(std::move(pair.first), std::move(pair.second));
+        if constexpr (Packed) {
+            scanKeys.reserve(items.size());
+            for (const auto &item : items) scanKeys.push_back(KDTreeKernel::pack(item.first));
+        }
+    }
+
+    Iterator begin() { return items.begin(); }
+
+    Iterator end() { return items.end(); }
+
+    Iterator find(const Key &key) {
+        return items.empty() ? end() : at(find<0>(key, 0));
+    }
+
+    template<size_t DIM>
+    Iterator findMin() {
+        return items.empty() ? end() : at(findMin<DIM, 0>(0));
+    }
+
+    Iterator findMin(size_t dim) {
+        return items.empty() ? end() : at(findMinDynamic<0>(dim));
+    }
+
+    template<size_t DIM>
+    Iterator findMax() {
+        return items.empty() ? end() : at(findMax<DIM, 0>(0));
+    }
+
+    Iterator findMax(size_t dim) {
+        return items.empty() ? end() : at(findMaxDynamic<0>(dim));
+    }
+
+    /**
+     * Find the nearest neighbor of key, the keys must be arithmetic
+     * Time complexity: O(log(n / B) + kB) expected for well distributed points, O(kn) worst case
+     * @tparam Metric KDTreeMetric::L2 (default), KDTreeMetric::L1 or KDTreeMetric::LInf
+     * @return iterator of the nearest pair, or end() if the tree is empty
+     */
+    template<typename Metric = KDTreeMetric::L2>
+    Iterator nearest(const Key &key) {
+        if (items.empty()) return end();
+        size_t best = items.size();
+        double bestDist = std::numeric_limits<double>::infinity();
+        ScanKey query;
+        if constexpr (Packed) query = KDTreeKernel::pack(key);
+        else query = key;
+        nearest<0, Metric>(key, query, 0, best, bestDist);
+        return at(best);
+    }
+
+    /**
+     * Visit all key-value pairs with lo <= key <= hi on every dimension
+     * Time complexity: O((n / B)^(1-1/k) B + m), m is the number of reported pairs
+     * @param lo lower corner of the box (inclusive)
+     * @param hi upper corner of the box (inclusive)
+     * @param visitor called with Data & of every pair in the box
+     */
+    template<typename Visitor>
+    void rangeQuery(const Key &lo, const Key &hi, Visitor &&visitor) {
+        if (items.empty()) return;
+        auto visit = [this, &visitor](size_t item) { visitor(items[item]); };
+        rangeQuery<0>(0, lo, hi, visit);
+    }
+
+    /**
+     * Time complexity: O((n / B)^(1-1/k) kB)
+     * @param lo lower corner of the box (inclusive)
+     * @param hi upper corner of the box (inclusive)
+     * @return the number of keys in the box
+     */
+    size_t rangeCount(const Key &lo, const Key &hi) const {
+        return items.empty() ? 0 : rangeCount<0>(0, lo, hi);
+    }
+
+    size_t getBucketSize() const { return bucketSize; }
+
+    size_t size() const { return items.size(); }
+
+    bool empty() const { return items.empty(); }
+};
+
+#endif //VE281P3_BUCKET_KDTREE_HPP
@@ -0,0 +1,399 @@
+#ifndef VE281P3_CONCURRENT_KDTREE_HPP
+#define VE281P3_CONCURRENT_KDTREE_HPP
+
+#include <tuple>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+/**
+ * An abstract template base of the ConcurrentKDTree class
+ */
+template<typename...>
+class ConcurrentKDTree;
+
+/**
+ * A KDTree for many concurrent readers and one writer at a time
+ * Nodes are immutable: insert and erase copy the path from the root to the changed node and publish the new root
+ * with one atomic store, so a reader always sees a complete version of the tree without taking any lock
+ * Replaced nodes are reclaimed by epochs: a reader announces the epoch it started in a slot of its own, and a node
+ * retired in epoch e is deleted once no slot holds an epoch <= e
+ * Readers work on a Snapshot, which pins one version of the tree for as long as it lives
+ * Taking a snapshot tries each of the MAX_SNAPSHOTS slots once, so it takes a bounded number of steps but fails
+ * when no slot is free, rather than waiting for one
+ * Writers are serialized by a mutex
+ * The time complexity of functions are based on n and k
+ * n is the size of the KDTree
+ * k is the number of dimensions
+ * @typedef Key         key type
+ * @typedef Value       value type
+ * @typedef Data        key-value pair
+ * @static  KeySize     k (number of dimensions)
+ */
+template<typename ValueType, typename... KeyTypes>
+class ConcurrentKDTree<std::tuple<KeyTypes...>, ValueType> {
+public:
+    typedef std::tuple<KeyTypes...> Key;
+    typedef ValueType Value;
+    typedef std::pair<const Key, Value> Data;
+    static inline constexpr size_t KeySize = std::tuple_size<Key>::value;
+    static inline constexpr size_t MAX_SNAPSHOTS = 128;    // snapshots alive at the same time
+    static_assert(KeySize > 0, "Can not construct ConcurrentKDTree with zero dimension");
+
+protected:
+    struct Node {
+        const Data data;
+        const Node *const left;
+        const Node *const right;
+        const size_t size;                  // number of nodes in the subtree
+
+        Node(const Key &key, const Value &value, const Node *left, const Node *right)
+                : data(key, value), left(left), right(right),
+                  size(1 + (left ? left->size : 0) + (right ? right->size : 0)) {}
+
+        const Key &key() const { return data.first; }
+
+        const Value &value() const { return data.second; }
+    };
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};     // epoch of the snapshot using this slot, 0 if idle
+    };
+
+    std::atomic<const Node *> root{nullptr};
+    std::atomic<uint64_t> globalEpoch{1};
+    Slot slots[MAX_SNAPSHOTS];
+    std::mutex writer;                                      // serializes insert and erase
+    std::vector<std::pair<uint64_t, const Node *>> retired; // replaced nodes and the epoch they were retired in
+
+    template<size_t DIM, typename Compare>
+    static bool compareKey(const Key &a, const Key &b, Compare compare = Compare()) {
+        if (std::get<DIM>(a) != std::get<DIM>(b)) {
+            return compare(std::get<DIM>(a), std::get<DIM>(b));
+        }
+        return compare(a, b);
+    }
+
+    template<size_t DIM>
+    static bool sortComp(const std::pair<Key, Value> &a, const std::pair<Key, Value> &b) {
+        return compareKey<DIM, std::less<>>(a.first, b.first);
+    }
+
+    static bool uniqueComp(const std::pair<Key, Value> &a, const std::pair<Key, Value> &b) {
+        return a.first == b.first;
+    }
+
+    template<size_t DIM>
+    static const Node *vectorConstruct(int left, int right, std::vector<std::pair<Key, Value>> &v) {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (left > right) return nullptr;
+        int mid = (left + right) / 2;
+        std::nth_element(v.begin() + left, v.begin() + mid, v.begin() + right + 1, sortComp<DIM>);
+        const Node *lower = vectorConstruct<DIM_NEXT>(left, mid - 1, v);
+        const Node *upper = vectorConstruct<DIM_NEXT>(mid + 1, right, v);
+        return new Node(v[mid].first, v[mid].second, lower, upper);
+    }
+
+    template<size_t DIM>
+    static const Node *find(const Key &key, const Node *node) {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (!node) return nullptr;
+        if (key == node->key()) return node;
+        if (compareKey<DIM, std::less<>>(key, node->key())) return find<DIM_NEXT>(key, node->left);
+        return find<DIM_NEXT>(key, node->right);
+    }
+
+    void retire(const Node *node) {
+        retired.emplace_back(globalEpoch.load(), node);
+    }
+
+    /**
+     * Copy the path to key with the key-value pair inserted, the replaced nodes are retired
+     * Time Complexity: O(k log n)
+     * @tparam DIM current dimension of node
+     * @return the new root of the subtree
+     */
+    template<size_t DIM>
+    const Node *insert(const Key &key, const Value &value, const Node *node) {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (!node) return new Node(key, value, nullptr, nullptr);
+        const Node *copy;
+        if (key == node->key()) {
+            copy = new Node(key, value, node->left, node->right);
+        } else if (compareKey<DIM, std::less<>>(key, node->key())) {
+            copy = new Node(node->key(), node->value(), insert<DIM_NEXT>(key, value, node->left),
+                            node->right);
+        } else {
+            copy = new Node(node->key(), node->value(), node->left,
+                            insert<DIM_NEXT>(key, value, node->right));
+        }
+        retire(node);
+        return copy;
+    }
+
+    template<size_t DIM_CMP, size_t DIM>
+    static const Node *findMin(const Node *node) {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (!node) return nullptr;
+        const Node *min = node;
+        auto update = [&min](const Node *candidate) {
+            if (candidate && compareKey<DIM_CMP, std::less<>>(candidate->key(), min->key())) min = candidate;
+        };
+        update(findMin<DIM_CMP, DIM_NEXT>(node->left));
+        if (DIM_CMP != DIM) update(findMin<DIM_CMP, DIM_NEXT>(node->right));
+        return min;
+    }
+
+    template<size_t DIM_CMP, size_t DIM>
+    static const Node *findMax(const Node *node) {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (!node) return nullptr;
+        const Node *max = node;
+        auto update = [&max](const Node *candidate) {
+            if (candidate && compareKey<DIM_CMP, std::greater<>>(candidate->key(), max->key())) max = candidate;
+        };
+        update(findMax<DIM_CMP, DIM_NEXT>(node->right));
+        if (DIM_CMP != DIM) update(findMax<DIM_CMP, DIM_NEXT>(node->left));
+        return max;
+    }
+
+    /**
+     * Copy the path to key with the key erased, the replaced nodes are retired
+     * The node with key takes the minimum of its right subtree (or the maximum of its left subtree),
+     * which is erased from that subtree in turn, exactly like KDTree::erase
+     * Time Complexity: max{O(k log n), O(findMin)}
+     * @tparam DIM current dimension of node
+     * @return the new root of the subtree, node itself if key is not found
+     */
+    template<size_t DIM>
+    const Node *erase(const Node *node, const Key &key) {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (!node) return nullptr;
+        const Node *copy;
+        if (key == node->key()) {
+            if (!node->left && !node->right) {
+                copy = nullptr;
+            } else if (node->right) {
+                const Node *min = findMin<DIM, DIM_NEXT>(node->right);
+                copy = new Node(min->key(), min->value(), node->left, erase<DIM_NEXT>(node->right, min->key()));
+            } else {
+                const Node *max = findMax<DIM, DIM_NEXT>(node->left);
+                copy = new Node(max->key(), max->value(), erase<DIM_NEXT>(node->left, max->key()), nullptr);
+            }
+        } else if (compareKey<DIM, std::less<>>(key, node->key())) {
+            const Node *left = erase<DIM_NEXT>(node->left, key);
+            if (left == node->left) return node;
+            copy = new Node(node->key(), node->value(), left, node->right);
+        } else {
+            const Node *right = erase<DIM_NEXT>(node->right, key);
+            if (right == node->right) return node;
+            copy = new Node(node->key(), node->value(), node->left, right);
+        }
+        retire(node);
+        return copy;
+    }
+
+    /**
+     * Delete the retired nodes that no snapshot can reach any more
+     * Called by the writer after publishing a new root
+     * Time Complexity: O(MAX_SNAPSHOTS + number of retired nodes)
+     */
+    void reclaim() {
+        // snapshots starting from now see the new root, older ones hold an epoch <= the current one
+        uint64_t oldest = globalEpoch.fetch_add(1) + 1;
+        for (auto &slot : slots) {
+            uint64_t epoch = slot.epoch.load();
+            if (epoch != 0) oldest = std::min(oldest, epoch);
+        }
+        auto it = std::partition(retired.begin(), retired.end(),
+                                 [oldest](const std::pair<uint64_t, const Node *> &node) { return node.first >= oldest; });
+        for (auto free = it; free != retired.end(); ++free) delete free->second;
+        retired.erase(it, retired.end());
+    }
+
+    static void destruct(const Node *node) {
+        if (!node) return;
+        destruct(node->left);
+        destruct(node->right);
+        delete node;
+    }
+
+public:
+    /**
+     * A consistent read-only version of the tree, unaffected by later updates
+     * Taking and dropping a snapshot never blocks, taking one throws if MAX_SNAPSHOTS snapshots are alive
+     * The tree must outlive its snapshots
+     */
+    class Snapshot {
+    private:
+        ConcurrentKDTree *tree;
+        size_t slot;
+        const Node *root;
+
+        explicit Snapshot(ConcurrentKDTree *tree) : tree(tree) {
+            static thread_local size_t hint = 0;
+            uint64_t epoch = tree->globalEpoch.load();
+            slot = MAX_SNAPSHOTS;
+            for (size_t tried = 0, i = hint; tried < MAX_SNAPSHOTS; tried++, i = (i + 1) % MAX_SNAPSHOTS) {
+                uint64_t idle = 0;
+                if (tree->slots[i].epoch.compare_exchange_strong(idle, epoch)) {
+                    slot = hint = i;
+                    break;
+                }
+            }
+            if (slot == MAX_SNAPSHOTS) throw std::length_error("too many snapshots!");
+            // the slot is announced before the root is read, so the writer can not free anything reachable
+            root = tree->root.load();
+        }
+
+    public:
+        friend class ConcurrentKDTree;
+
+        /**
+         * An in-order forward iterator over the snapshot
+         */
+        class Iterator {
+        private:
+            std::vector<const Node *> stack;    // the current node and the ancestors whose left subtree it is in
+
+            void pushLeft(const Node *node) {
+                for (; node; node = node->left) stack.push_back(node);
+            }
+
+        public:
+            friend class Snapshot;
+
+            Iterator() = default;
+
+            explicit Iterator(const Node *root) { pushLeft(root); }
+
+            Iterator &operator++() {
+                const Node *node = stack.back();
+                stack.pop_back();
+                pushLeft(node->right);
+                return *this;
+            }
+
+            bool operator==(const Iterator &that) const {
+                return stack.empty() ? that.stack.empty() : !that.stack.empty() && stack.back() == that.stack.back();
+            }
+
+            bool operator!=(const Iterator &that) const { return !(*this == that); }
+
+            const Data *operator->() const { return &stack.back()->data; }
+
+            const Data &operator*() const { return stack.back()->data; }
+        };
+
+        Snapshot(const Snapshot &) = delete;
+
+        Snapshot &operator=(const Snapshot &) = delete;
+
+        ~Snapshot() { tree->slots[slot].epoch.store(0); }
+
+        Iterator begin() const { return Iterator(root); }
+
+        Iterator end() const { return Iterator(); }
+
+        /**
+         * Time complexity: O(k log n)
+         * @return pointer to the value of key in this snapshot, or nullptr if not found
+         */
+        const Value *find(const Key &key) const {
+            const Node *node = ConcurrentKDTree::find<0>(key, root);
+            return node ? &node->value() : nullptr;
+        }
+
+        bool contains(const Key &key) const { return find(key) != nullptr; }
+
+        size_t size() const { return root ? root->size : 0; }
+
+        bool empty() const { return root == nullptr; }
+    };
+
+    ConcurrentKDTree() = default;
+
+    /**
+     * Same semantics as the KDTree constructor: if a key appears more than once, the last value is kept
+     * Time complexity: O(kn log n)
+     * @param v we pass by value here because v need to be modified
+     */
+    explicit ConcurrentKDTree(std::vector<std::pair<Key, Value>> v) {
+        std::stable_sort(v.begin(), v.end(), sortComp<0>);
+        auto ip = std::unique(v.rbegin(), v.rend(), uniqueComp);
+        v.erase(v.begin(), ip.base());
+        root.store(vectorConstruct<0>(0, (int) v.size() - 1, v));
+    }
+
+    ConcurrentKDTree(const ConcurrentKDTree &) = delete;
+
+    ConcurrentKDTree &operator=(const ConcurrentKDTree &) = delete;
+
+    /**
+     * No snapshot may be alive
+     * Time complexity: O(n)
+     */
+    ~ConcurrentKDTree() {
+        destruct(root.load());
+        for (auto &node : retired) delete node.second;
+    }
+
+    /**
+     * Pin the current version of the tree
+     * Time complexity: O(1) while few snapshots are alive, O(MAX_SNAPSHOTS) worst case
+     * @throw std::length_error if MAX_SNAPSHOTS snapshots are alive
+     */
+    Snapshot snapshot() {
+        return Snapshot(this);
+    }
+
+    /**
+     * Insert the key-value pair, if the key already exists, replace the value only
+     * Readers are never blocked, they see the tree either before or after the insertion
+     * Time complexity: O(k log n)
+     */
+    void insert(const Key &key, const Value &value) {
+        std::lock_guard<std::mutex> lock(writer);
+        root.store(insert<0>(key, value, root.load()));
+        reclaim();
+    }
+
+    /**
+     * Readers are never blocked, they see the tree either before or after the erasure
+     * Time complexity: max{O(k log n), O(findMin)}
+     * @return whether the key is erased
+     */
+    bool erase(const Key &key) {
+        std::lock_guard<std::mutex> lock(writer);
+        const Node *oldRoot = root.load();
+        const Node *newRoot = erase<0>(oldRoot, key);
+        if (newRoot == oldRoot) return false;
+        root.store(newRoot);
+        reclaim();
+        return true;
+    }
+
+    /**
+     * Time complexity: O(k log n)
+     * @return whether key is in the current version of the tree
+     */
+    bool contains(const Key &key) {
+        return snapshot().contains(key);
+    }
+
+    /**
+     * Time complexity: O(1)
+     * @return the size of the current version of the tree
+     */
+    size_t size() {
+        return snapshot().size();
+    }
+};
+
+#endif //VE281P3_CONCURRENT_KDTREE_HPP
@@ -1,8 +1,16 @@
 #include <tuple>
 #include <vector>
 #include <algorithm>
+#include <bitset>
 #include <cassert>
+#include <cmath>
+#include <queue>
 #include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+#include "kdtree_metric.hpp"
+#include "node_arena.hpp"
 
 /**
  * An abstract template base of the KDTree class
@@ -31,11 +39,11 @@ public:
 protected:
     struct Node {
         Data data;
-        Node *parent;
         Node *left = nullptr;
         Node *right = nullptr;
+        size_t size = 1;                // number of nodes in the subtree
 
-        Node(const Key &key, const Value &value, Node *parent) : data(key, value), parent(parent) {}
+        Node(const Key &key, const Value &value) : data(key, value) {}
 
         const Key &key() { return data.first; }
 
@@ -49,56 +57,123 @@ public:
      */
     class Iterator {
     private:
+        static constexpr size_t PATH_CAPACITY = 32;     // enough for a balanced tree of 2^32 nodes
+
         KDTree *tree;
         Node *node;
+        bool recorded;                  // whether the ancestors of node are kept, always true at the root
+        size_t depth = 0;               // depth of node, the number of ancestors kept
+        Node *path[PATH_CAPACITY];      // the ancestors at depth 0 to PATH_CAPACITY - 1
+        std::vector<Node *> spilled;    // deeper ancestors, only allocated in a degenerate tree
+
+        Iterator(KDTree *tree, Node *node) : tree(tree), node(node), recorded(!node || node == tree->root) {}
+
+        Node *&ancestor(size_t d) {
+            return d < PATH_CAPACITY ? path[d] : spilled[d - PATH_CAPACITY];
+        }
+
+        // popping only moves depth, so the entries below a saved depth stay valid until something is pushed
+        void pushAncestor(Node *parent) {
+            if (depth >= PATH_CAPACITY + spilled.size()) spilled.push_back(parent);
+            else ancestor(depth) = parent;
+            depth++;
+        }
 
-        Iterator(KDTree *tree, Node *node) : tree(tree), node(node) {}
+        /**
+         * Search the path from the root to node, when the ancestors were never recorded
+         * (e.g. the iterator comes from findMin), once per iterator
+         * Time complexity: O(k log n)
+         */
+        void reloadPath() {
+            depth = 0;
+            recorded = true;
+            Node *curr = tree->root;
+            for (size_t dim = 0; curr != node; dim = nextDim(dim)) {
+                pushAncestor(curr);
+                curr = compareKeyDynamic<std::less<>>(dim, node->key(), curr->key()) ? curr->left : curr->right;
+            }
+        }
+
+        /**
+         * Move up to the parent
+         * @return the parent, or nullptr if node is the root
+         */
+        Node *popAncestor() {
+            if (depth == 0) return nullptr;
+            return ancestor(--depth);
+        }
 
         /**
          * Increment the iterator
-         * Time complexity: O(log n)
+         * Time complexity: O(log n), O(1) amortized over a full iteration
          */
         void increment() {
             // TODO: implement this function
             if(!node) return;
+            if(!recorded) reloadPath();
             // if there is right subtree, go to its smallest element
             if(node->right){
+                pushAncestor(node);
                 node = node->right;
-                while(node->left) node = node->left;
+                while(node->left){
+                    pushAncestor(node);
+                    node = node->left;
+                }
                 return;
             }
             // else find the parent where the node is in its left subtree
-            while(node->parent && node->parent->left!=node)
-                node = node->parent;
-            // parent is either null or a node
-            node = node->parent;
+            while(Node *parent = popAncestor()){
+                if(parent->left == node){
+                    node = parent;
+                    return;
+                }
+                node = parent;
+            }
+            // the last node has no successor
+            node = nullptr;
         }
 
         /**
          * Decrement the iterator
-         * Time complexity: O(log n)
+         * Time complexity: O(log n), O(1) amortized over a full iteration
          */
         void decrement() {
             // TODO: implement this function
             // if not node, then get to the largest element
             if(!node){
+                depth = 0;
+                recorded = true;
                 node = tree->root;
-                while(node->right) node = node->right;
+                if(!node) return;
+                while(node->right){
+                    pushAncestor(node);
+                    node = node->right;
+                }
                 return;
-            } // else if there is a left subtree, find the next greatest element
+            }
+            if(!recorded) reloadPath();
+            // else if there is a left subtree, find the next greatest element
             if(node->left){
+                pushAncestor(node);
                 node = node->left;
-                while(node->right) node = node->right;
+                while(node->right){
+                    pushAncestor(node);
+                    node = node->right;
+                }
                 return;
             } // otherwise, get to the node where the current node is in its right subtree
-            Node *cp = node;
-            while(node->parent && node->parent->left == node){
-                node = node->parent;
+            Node *first = node;
+            size_t firstDepth = depth;
+            while(Node *parent = popAncestor()){
+                if(parent->right == node){
+                    node = parent;
+                    return;
+                }
+                node = parent;
             }
-            if(!node->parent){
-                node = cp;
-            } // parent is either a node or null
-            else node = node->parent;
+            // the first node has no predecessor, stay there; its ancestors are still in place
+            node = first;
+            depth = firstDepth;
         }
 
     public:
@@ -151,54 +226,129 @@ public:
 
 protected:                      // DO NOT USE private HERE!
     Node *root = nullptr;       // root of the tree
+    NodeArena<Node> arena;      // memory of all nodes
     size_t treeSize = 0;        // size of the tree
+    double balanceFactor = 0;   // alpha of scapegoat rebalancing, 0 if disabled
+    size_t maxTreeSize = 0;     // maximum size of the tree since the last full rebuild
 
     /**
      * Find the node with key
      * Time Complexity: O(k log n)
-     * @tparam DIM current dimension of node
      * @param key
      * @param node
+     * @param dim dimension of node
      * @return the node with key, or nullptr if not found
      */
-    template<size_t DIM>
-    Node *find(const Key &key, Node *node) {
-        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+    Node *find(const Key &key, Node *node, size_t dim = 0) {
         // TODO: implement this function
-        if(!node) return nullptr;
-        if(key == node->key()) return node;
-        if(std::get<DIM>(node->key()) <= std::get<DIM>(key))
-            return find<DIM_NEXT>(key, node->right);
-        return find<DIM_NEXT>(key, node->left);
+        for(; node && !(key == node->key()); dim = nextDim(dim)){
+            node = compareKeyDynamic<std::less<>>(dim, key, node->key()) ? node->left : node->right;
+        }
+        return node;
     }
 
     /**
      * Insert the key-value pair, if the key already exists, replace the value only
-     * Time Complexity: O(k log n)
-     * @tparam DIM current dimension of node
+     * The sizes on the path are incremented on the way down, and restored if the key already exists
+     * If rebalancing is enabled and the new node is too deep, an unbalanced ancestor is rebuilt
+     * Time Complexity: O(k log n), amortized with rebalancing
      * @param key
      * @param value
-     * @param node
-     * @param parent
+     * @param node root of the subtree, on dimension 0
      * @return whether insertion took place (return false if the key already exists)
      */
-    template<size_t DIM>
-    bool insert(const Key &key, const Value &value, Node *&node, Node *parent) {
-        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+    bool insert(const Key &key, const Value &value, Node *&node) {
         // TODO: implement this function
-        // if not node, create a node and return it
-        if(!node){
-            node = new Node(key, value, parent);
-            treeSize++;
-            return true;
-        }                               // if key is found (all dimensions are equal), change its value and return false
-        if(key == node->key()){
-            node->value() = value;
-            return false;
-        }                               // otherwise, go to the proper subtree
-        if(std::get<DIM>(node->key()) <= std::get<DIM>(key))
-            return insert<DIM_NEXT>(key, value, node->right, node);
-        return insert<DIM_NEXT>(key, value, node->left, node);
+        Node **link = &node;
+        size_t dim = 0, depth = 0;
+        for(; *link; dim = nextDim(dim), depth++){
+            Node *curr = *link;
+            // if key is found (all dimensions are equal), change its value and return false
+            if(key == curr->key()){
+                curr->value() = value;
+                size_t undoDim = 0;
+                for(Node *undo = node; undo != curr; undoDim = nextDim(undoDim)){
+                    undo->size--;
+                    undo = compareKeyDynamic<std::less<>>(undoDim, key, undo->key()) ? undo->left : undo->right;
+                }
+                return false;
+            }
+            // otherwise, go to the proper subtree
+            curr->size++;
+            link = compareKeyDynamic<std::less<>>(dim, key, curr->key()) ? &curr->left : &curr->right;
+        }
+        *link = new(arena.allocate()) Node(key, value);
+        treeSize++;
+        if(balanceFactor > 0 && depth > maxBalancedDepth()) rebuildScapegoat(node, key);
+        return true;
+    }
+
+    /**
+     * Rebuild the deepest unbalanced ancestor of the node with key, the scapegoat
+     * Time Complexity: O(km log m) amortized, m is the size of the rebuilt subtree
+     * @param node root of the subtree, on dimension 0
+     * @param key
+     */
+    void rebuildScapegoat(Node *&node, const Key &key) {
+        Node **scapegoat = nullptr;
+        size_t scapegoatDim = 0;
+        Node **link = &node;
+        for(size_t dim = 0; !(key == (*link)->key()); dim = nextDim(dim)){
+            if(isUnbalanced(*link)){
+                scapegoat = link;
+                scapegoatDim = dim;
+            }
+            link = compareKeyDynamic<std::less<>>(dim, key, (*link)->key()) ? &(*link)->left : &(*link)->right;
+        }
+        if(scapegoat) *scapegoat = rebuild(*scapegoat, scapegoatDim);
+    }
+
+    /**
+     * Maximum depth of an alpha-weight-balanced tree, log_{1/alpha}(n)
+     */
+    size_t maxBalancedDepth() const {
+        return (size_t) (std::log((double) treeSize) / std::log(1 / balanceFactor));
+    }
+
+    bool isUnbalanced(Node *node) const {
+        auto heavier = std::max(subtreeSize(node->left), subtreeSize(node->right));
+        return (double) heavier > balanceFactor * (double) node->size;
+    }
+
+    /**
+     * Rebuild a subtree into a perfectly balanced one with vectorConstruct, in the memory of its own nodes
+     * Time Complexity: O(km log m), m is the size of the subtree
+     * @param node
+     * @param dim dimension of node
+     * @return the root of the new subtree
+     */
+    Node *rebuild(Node *node, size_t dim) {
+        std::vector<std::pair<Key, Value>> v;
+        std::vector<Node *> nodes;
+        v.reserve(node->size);
+        nodes.reserve(node->size);
+        std::vector<Node *> stack{node};
+        while (!stack.empty()) {
+            Node *curr = stack.back();
+            stack.pop_back();
+            v.emplace_back(curr->key(), curr->value());
+            nodes.push_back(curr);
+            if (curr->left) stack.push_back(curr->left);
+            if (curr->right) stack.push_back(curr->right);
+        }
+        for (auto curr : nodes) curr->~Node();
+        auto slots = [&nodes](int i) -> void * { return nodes[i]; };
+        return vectorConstructDynamic(dim, 0, (int) v.size() - 1, v, slots, std::index_sequence_for<KeyTypes...>());
+    }
+
+    /**
+     * Rebuild the whole tree if it shrank below alpha times its maximum size
+     */
+    void rebalanceAfterErase() {
+        if (balanceFactor > 0 && (double) treeSize < balanceFactor * (double) maxTreeSize) {
+            if (root) root = rebuild(root, 0);
+            maxTreeSize = treeSize;
+        }
     }
 
     /**
@@ -219,6 +369,26 @@ protected:                      // DO NOT USE private HERE!
         return compare(a, b);
     }
 
+    /**
+     * Compare two keys on a dimension known at runtime
+     * Time Complexity: O(1)
+     */
+    template<typename Compare, size_t... DIMS>
+    static bool compareKeyDynamic(size_t dim, const Key &a, const Key &b, std::index_sequence<DIMS...>) {
+        bool result = false;
+        ((dim == DIMS && (result = compareKey<DIMS, Compare>(a, b), true)) || ...);
+        return result;
+    }
+
+    template<typename Compare>
+    static bool compareKeyDynamic(size_t dim, const Key &a, const Key &b) {
+        return compareKeyDynamic<Compare>(dim, a, b, std::index_sequence_for<KeyTypes...>());
+    }
+
+    static size_t nextDim(size_t dim) {
+        return dim + 1 == KeySize ? 0 : dim + 1;
+    }
+
     /**
      * Compare two nodes on a dimension
      * Time Complexity: O(1)
@@ -237,168 +407,408 @@ protected:                      // DO NOT USE private HERE!
     }
 
     /**
-     * Find the minimum node on a dimension
-     * Time Complexity: ?
+     * Find the minimum node on a dimension, with an explicit stack
+     * Only the left subtree of a node splitting on DIM_CMP can hold the minimum
+     * Time Complexity: O(n^(1-1/k)) for a balanced tree
      * @tparam DIM_CMP comparison dimension
-     * @tparam DIM current dimension of node
      * @param node
+     * @param dim dimension of node
      * @return the minimum node on a dimension
      */
-    template<size_t DIM_CMP, size_t DIM>
-    Node *findMin(Node *node) {
-        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+    template<size_t DIM_CMP>
+    Node *findMin(Node *node, size_t dim) {
         // TODO: implement this function
-        if(!node) return nullptr;
-        // find the minimum in left subtree
-        Node *min = findMin<DIM_CMP, DIM_NEXT>(node->left);
-        if(DIM_CMP!=DIM){
-            // if current node doesnt have the same DIM, then compare with the minimum from right subtree too
-            Node *rightMin = findMin<DIM_CMP, DIM_NEXT>(node->right);
-            min = compareNode<DIM_CMP, std::less<>>(min, rightMin);
+        Node *min = nullptr;
+        std::vector<std::pair<Node *, size_t>> stack;
+        while(true){
+            for(; node; dim = nextDim(dim)){
+                // compare with the current node and keep the minimum one
+                min = compareNode<DIM_CMP, std::less<>>(node, min);
+                // if current node doesnt have the same DIM, then the right subtree needs a visit too
+                if(dim != DIM_CMP && node->right) stack.emplace_back(node->right, nextDim(dim));
+                node = node->left;
+            }
+            if(stack.empty()) return min;
+            std::tie(node, dim) = stack.back();
+            stack.pop_back();
         }
-        // compare with the current node and return the minimum one
-        return compareNode<DIM_CMP, std::less<>>(node, min);
     }
 
     /**
-     * Find the maximum node on a dimension
-     * Time Complexity: ?
+     * Find the maximum node on a dimension, with an explicit stack
+     * Only the right subtree of a node splitting on DIM_CMP can hold the maximum
+     * Time Complexity: O(n^(1-1/k)) for a balanced tree
      * @tparam DIM_CMP comparison dimension
-     * @tparam DIM current dimension of node
      * @param node
+     * @param dim dimension of node
      * @return the maximum node on a dimension
      */
-    template<size_t DIM_CMP, size_t DIM>
-    Node *findMax(Node *node) {
-        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+    template<size_t DIM_CMP>
+    Node *findMax(Node *node, size_t dim) {
         // TODO: implement this function
-        if(!node) return nullptr;
-        // find the maximum from right subtree
-        Node *max = findMax<DIM_CMP, DIM_NEXT>(node->right);
-        if(DIM_CMP!=DIM){
-            // if current node doesnt have the same DIM, then compare with the maximum from left subtree too
-            Node *leftMax = findMax<DIM_CMP, DIM_NEXT>(node->left);
-            max = compareNode<DIM_CMP, std::greater<>>(max, leftMax);
+        Node *max = nullptr;
+        std::vector<std::pair<Node *, size_t>> stack;
+        while(true){
+            for(; node; dim = nextDim(dim)){
+                // compare with the current node and keep the maximum one
+                max = compareNode<DIM_CMP, std::greater<>>(node, max);
+                // if current node doesnt have the same DIM, then the left subtree needs a visit too
+                if(dim != DIM_CMP && node->left) stack.emplace_back(node->left, nextDim(dim));
+                node = node->right;
+            }
+            if(stack.empty()) return max;
+            std::tie(node, dim) = stack.back();
+            stack.pop_back();
         }
-        // compare with the current node and return the maximum one
-        return compareNode<DIM_CMP, std::greater<>>(node, max);
     }
 
-    template<size_t DIM>
-    Node *findMinDynamic(size_t dim) {
-        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
-        if (dim >= KeySize) {
-            dim %= KeySize;
-        }
-        if (dim == DIM) return findMin<DIM, 0>(root);
-        return findMinDynamic<DIM_NEXT>(dim);
+    template<size_t... DIMS>
+    Node *findMinDynamic(size_t dimCmp, Node *node, size_t dim, std::index_sequence<DIMS...>) {
+        Node *result = nullptr;
+        ((dimCmp == DIMS && (result = findMin<DIMS>(node, dim), true)) || ...);
+        return result;
     }
 
-    template<size_t DIM>
-    Node *findMaxDynamic(size_t dim) {
-        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
-        if (dim >= KeySize) {
-            dim %= KeySize;
-        }
-        if (dim == DIM) return findMax<DIM, 0>(root);
-        return findMaxDynamic<DIM_NEXT>(dim);
+    Node *findMinDynamic(size_t dimCmp, Node *node, size_t dim) {
+        return findMinDynamic(dimCmp % KeySize, node, dim, std::index_sequence_for<KeyTypes...>());
+    }
+
+    template<size_t... DIMS>
+    Node *findMaxDynamic(size_t dimCmp, Node *node, size_t dim, std::index_sequence<DIMS...>) {
+        Node *result = nullptr;
+        ((dimCmp == DIMS && (result = findMax<DIMS>(node, dim), true)) || ...);
+        return result;
+    }
+
+    Node *findMaxDynamic(size_t dimCmp, Node *node, size_t dim) {
+        return findMaxDynamic(dimCmp % KeySize, node, dim, std::index_sequence_for<KeyTypes...>());
     }
 
     /**
-     * Erase a node with key (check the pseudocode in project description)
+     * Erase the node with key iteratively (check the pseudocode in project description)
+     * A node with a right subtree takes the minimum of that subtree on its dimension, otherwise the maximum of
+     * its left subtree, and the replacement is then erased from that subtree by the following iterations
      * Time Complexity: max{O(k log n), O(findMin)}
-     * @tparam DIM current dimension of node
-     * @param node
+     * @param node root of the subtree
      * @param key
-     * @return nullptr if node is erased, else the (probably) replaced node
+     * @param dim dimension of node
+     * @return whether a node is erased
      */
-    template<size_t DIM>
-    Node *erase(Node *node, const Key &key) {
-        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+    bool erase(Node *&node, const Key &key, size_t dim = 0) {
         // TODO: implement this function
-        if(!node) return nullptr;
-
-        if(key==node->key()){
-            if(!node->left && !node->right){
-                delete node;
-                treeSize--;
-                return nullptr;
-            }
-            else if(node->right){
-                Node *minNode = findMin<DIM, DIM_NEXT>(node->right);
-                //Key tmpKey = minNode->key();
-                const_cast<Key &>(node->key()) = minNode->key();
-                node->value() = minNode->value();
-                node->right = erase<DIM_NEXT>(node->right, minNode->key());
-            }
-            else if(node->left){
-                Node *maxNode = findMax<DIM, DIM_NEXT>(node->left);
-                //Key tmpKey = maxNode->key();
-                const_cast<Key &>(node->key()) = maxNode->key();
-                node->value() = maxNode->value();
-                node->left = erase<DIM_NEXT>(node->left, maxNode->key());
-            }
-        }
-        else{
-            if(std::get<DIM>(key) < std::get<DIM>(node->key())){
-                node->left = erase<DIM_NEXT>(node->left, key);
+        if(!find(key, node, dim)) return false;
+        Key target = key;
+        Node **link = &node;
+        while(true){
+            Node *curr = *link;
+            size_t next = nextDim(dim);
+            if(target == curr->key()){
+                if(!curr->left && !curr->right){
+                    arena.deallocate(curr);
+                    *link = nullptr;
+                    treeSize--;
+                    return true;
+                }
+                Node *replacement = curr->right ? findMinDynamic(dim, curr->right, next)
+                                                : findMaxDynamic(dim, curr->left, next);
+                const_cast<Key &>(curr->key()) = replacement->key();
+                curr->value() = replacement->value();
+                target = curr->key();
+                link = curr->right ? &curr->right : &curr->left;
             }
             else{
-                node->right = erase<DIM_NEXT>(node->right, key);
+                link = compareKeyDynamic<std::less<>>(dim, target, curr->key()) ? &curr->left : &curr->right;
             }
+            curr->size--;
+            dim = next;
         }
-        return node;
-    }
-
-    template<size_t DIM>
-    Node *eraseDynamic(Node *node, size_t dim) {
-        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
-        if (dim >= KeySize) {
-            dim %= KeySize;
-        }
-        if (dim == DIM) return erase<DIM>(node, node->key());
-        return eraseDynamic<DIM_NEXT>(node, dim);
     }
 
     // TODO: define your helper functions here if necessary
-    // copy the other tree through its root node
-    Node* copyFrom(Node *parent, Node *thatRoot){
+    // copy the other tree through its root node in one pass, into a single block in preorder
+    Node* copyFrom(Node *thatRoot){
         if(!thatRoot) return nullptr;
-        Node *curr = new Node(thatRoot->key(), thatRoot->value(), parent);
-        curr->left = copyFrom(curr, thatRoot->left);
-        curr->right = copyFrom(curr, thatRoot->right);
-        return curr;
+        Node *nodes = arena.allocateBlock(thatRoot->size);
+        size_t next = 0;
+        Node *result = nullptr;
+        std::vector<std::pair<Node *, Node **>> stack{{thatRoot, &result}};
+        while(!stack.empty()){
+            auto [from, link] = stack.back();
+            stack.pop_back();
+            if(!from) continue;
+            Node *curr = *link = new(nodes + next++) Node(from->key(), from->value());
+            curr->size = from->size;
+            stack.emplace_back(from->right, &curr->right);
+            stack.emplace_back(from->left, &curr->left);
+        }
+        return result;
     }
-    // delete the tree using its root node
-    void destruct(Node *node){
-        if(!node) return;
-        destruct(node->left);
-        destruct(node->right);
-        delete node;
+    // delete the whole tree, the nodes are only visited if they need destructors, then all blocks are released
+    void destruct(){
+        if constexpr (!std::is_trivially_destructible_v<Node>){
+            // rotate left children up instead of recursing
+            Node *node = root;
+            while(node){
+                if(node->left){
+                    Node *left = node->left;
+                    node->left = left->right;
+                    left->right = node;
+                    node = left;
+                }
+                else{
+                    Node *right = node->right;
+                    node->~Node();
+                    node = right;
+                }
+            }
+        }
+        arena.release();
+        root = nullptr;
+        treeSize = 0;
     }
-    static bool uniqueComp(const Data &a, const Data &b) {
+    void swap(KDTree &that) noexcept {
+        std::swap(root, that.root);
+        arena.swap(that.arena);
+        std::swap(treeSize, that.treeSize);
+        std::swap(balanceFactor, that.balanceFactor);
+        std::swap(maxTreeSize, that.maxTreeSize);
+    }
+    static bool uniqueComp(const std::pair<Key, Value> &a, const std::pair<Key, Value> &b) {
         return a.first == b.first;
     }
 
     template <size_t DIM>
-    static bool sortComp(const Data &a, const Data &b) {
+    static bool sortComp(const std::pair<Key, Value> &a, const std::pair<Key, Value> &b) {
         return compareKey<DIM, std::less<>>(a.first, b.first);
     }
     // deep copy helper function, creates a tree out of vector
-    template<size_t DIM>
-    Node *vectorConstruct(Node *parent, int left, int right, std::vector<std::pair<Key, Value>> &v){
+    // the node of v[i] is constructed in the memory slots(i)
+    template<size_t DIM, typename Slots>
+    Node *vectorConstruct(int left, int right, std::vector<std::pair<Key, Value>> &v, const Slots &slots){
         constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
         if(left>right) return nullptr;
 
         int mid = (left+right)/2;
-        std::nth_element(v.begin() + left, v.begin() + mid, v.begin()+right, sortComp<DIM>);
+        std::nth_element(v.begin() + left, v.begin() + mid, v.begin() + right + 1, sortComp<DIM>);
+
+        Node* curr = new(slots(mid)) Node(v[mid].first, v[mid].second);
+        curr->size = right - left + 1;
+        curr->left = vectorConstruct<DIM_NEXT>(left, mid-1, v, slots);
+        curr->right = vectorConstruct<DIM_NEXT>(mid+1, right, v, slots);
+        return curr;
+    }
+
+    template<typename Slots, size_t... DIMS>
+    Node *vectorConstructDynamic(size_t dim, int left, int right, std::vector<std::pair<Key, Value>> &v,
+                                 const Slots &slots, std::index_sequence<DIMS...>) {
+        Node *result = nullptr;
+        ((dim == DIMS && (result = vectorConstruct<DIMS>(left, right, v, slots), true)) || ...);
+        return result;
+    }
+
+    static constexpr int PARALLEL_GRAIN = 1 << 14;     // subtrees smaller than this are built serially
+
+    // run func(0), ..., func(tasks - 1) on their own threads and wait for all of them
+    template<typename Func>
+    static void parallelFor(size_t tasks, Func func) {
+        std::vector<std::thread> workers;
+        workers.reserve(tasks);
+        for (size_t i = 0; i < tasks; i++) workers.emplace_back(func, i);
+        for (auto &worker : workers) worker.join();
+    }
+
+    /**
+     * Stable sort v by sortComp<0> with threads chunks sorted concurrently, then merged pairwise in parallel
+     * Time complexity: O(n log n / threads + n log threads)
+     */
+    static void parallelSort(std::vector<std::pair<Key, Value>> &v, unsigned threads) {
+        std::vector<size_t> bounds(threads + 1);
+        for (size_t i = 0; i <= threads; i++) bounds[i] = v.size() * i / threads;
+        parallelFor(threads, [&](size_t i) {
+            std::stable_sort(v.begin() + bounds[i], v.begin() + bounds[i + 1], sortComp<0>);
+        });
+        for (size_t width = 1; width < threads; width *= 2) {
+            parallelFor((threads + 2 * width - 1) / (2 * width), [&](size_t i) {
+                size_t first = 2 * width * i, middle = first + width, last = std::min(first + 2 * width, (size_t) threads);
+                if (middle >= last) return;
+                std::inplace_merge(v.begin() + bounds[first], v.begin() + bounds[middle], v.begin() + bounds[last],
+                                   sortComp<0>);
+            });
+        }
+    }
+
+    /**
+     * Remove duplicate keys from sorted v, keeping the last occurrence like the serial constructor
+     * Each chunk is compacted in parallel, then the chunks are moved together
+     * Time complexity: O(n / threads + n)
+     */
+    static void parallelUnique(std::vector<std::pair<Key, Value>> &v, unsigned threads) {
+        std::vector<size_t> bounds(threads + 1), kept(threads);
+        for (size_t i = 0; i <= threads; i++) bounds[i] = v.size() * i / threads;
+        // whether the last element of each chunk survives, decided before any chunk is modified
+        std::vector<char> keepLast(threads);
+        for (size_t i = 0; i < threads; i++) {
+            size_t end = bounds[i + 1];
+            keepLast[i] = end == v.size() || !uniqueComp(v[end - 1], v[end]);
+        }
+        parallelFor(threads, [&](size_t i) {
+            size_t out = bounds[i];
+            for (size_t j = bounds[i]; j < bounds[i + 1]; j++) {
+                bool keep = j + 1 == bounds[i + 1] ? keepLast[i] : !uniqueComp(v[j], v[j + 1]);
+                if (!keep) continue;
+                if (out != j) v[out] = std::move(v[j]);
+                out++;
+            }
+            kept[i] = out - bounds[i];
+        });
+        size_t out = kept[0];
+        for (size_t i = 1; i < threads; i++) {
+            std::move(v.begin() + bounds[i], v.begin() + bounds[i] + kept[i], v.begin() + out);
+            out += kept[i];
+        }
+        v.erase(v.begin() + out, v.end());
+    }
+
+    /**
+     * Same as vectorConstruct, but the two subtrees of a large node are built concurrently
+     * The tree has exactly the same shape as the one built by vectorConstruct
+     * Every slot is written by one thread only, so no synchronization is needed for the memory
+     * @param threads number of threads available for this subtree
+     */
+    template<size_t DIM, typename Slots>
+    Node *vectorConstructParallel(int left, int right, std::vector<std::pair<Key, Value>> &v, const Slots &slots,
+                                  unsigned threads) {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (threads <= 1 || right - left < PARALLEL_GRAIN) return vectorConstruct<DIM>(left, right, v, slots);
+
+        int mid = (left+right)/2;
+        std::nth_element(v.begin() + left, v.begin() + mid, v.begin() + right + 1, sortComp<DIM>);
 
-        Node* curr = new Node(v[mid].first, v[mid].second, parent);
-        curr->left = vectorConstruct<DIM_NEXT>(curr, left, mid-1, v);
-        curr->right = vectorConstruct<DIM_NEXT>(curr, mid+1, right, v);
+        Node* curr = new(slots(mid)) Node(v[mid].first, v[mid].second);
+        curr->size = right - left + 1;
+        std::thread worker([&] {
+            curr->left = vectorConstructParallel<DIM_NEXT>(left, mid - 1, v, slots, threads / 2);
+        });
+        curr->right = vectorConstructParallel<DIM_NEXT>(mid + 1, right, v, slots, threads - threads / 2);
+        worker.join();
         return curr;
     }
 
+    static size_t subtreeSize(Node *node) {
+        return node ? node->size : 0;
+    }
+
+    template<size_t... DIMS>
+    static bool inBox(const Key &key, const Key &lo, const Key &hi, std::index_sequence<DIMS...>) {
+        return ((std::get<DIMS>(lo) <= std::get<DIMS>(key) && std::get<DIMS>(key) <= std::get<DIMS>(hi)) && ...);
+    }
+
+    static bool inBox(const Key &key, const Key &lo, const Key &hi) {
+        return inBox(key, lo, hi, std::index_sequence_for<KeyTypes...>());
+    }
+
+    /**
+     * Visit all nodes with lo <= key <= hi on every dimension
+     * A subtree is skipped if the box lies entirely on the other side of its splitting plane
+     * Time Complexity: O(n^(1-1/k) + m) for a balanced tree, m is the number of reported nodes
+     * @tparam DIM current dimension of node
+     * @param visitor called with every Node * in the box
+     */
+    template<size_t DIM, typename Visitor>
+    void rangeQuery(Node *node, const Key &lo, const Key &hi, Visitor &visitor) {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (!node) return;
+        if (inBox(node->key(), lo, hi)) visitor(node);
+        // the left subtree is not greater than node on DIM, the right subtree is not less
+        if (!(std::get<DIM>(node->key()) < std::get<DIM>(lo))) rangeQuery<DIM_NEXT>(node->left, lo, hi, visitor);
+        if (!(std::get<DIM>(hi) < std::get<DIM>(node->key()))) rangeQuery<DIM_NEXT>(node->right, lo, hi, visitor);
+    }
+
+    /**
+     * The region of a subtree, bounded on a dimension only if some ancestor splits on it
+     */
+    struct Cell {
+        Key lo, hi;
+        std::bitset<KeySize> hasLo, hasHi;
+    };
+
+    template<size_t... DIMS>
+    static bool cellInBox(const Cell &cell, const Key &lo, const Key &hi, std::index_sequence<DIMS...>) {
+        return ((cell.hasLo[DIMS] && cell.hasHi[DIMS] &&
+                 std::get<DIMS>(lo) <= std::get<DIMS>(cell.lo) && std::get<DIMS>(cell.hi) <= std::get<DIMS>(hi)) && ...);
+    }
+
+    /**
+     * Count the nodes with lo <= key <= hi on every dimension
+     * If the region of a subtree is inside the box, its size is used without visiting it
+     * Time Complexity: O(n^(1-1/k)) for a balanced tree
+     * @tparam DIM current dimension of node
+     * @param cell region of the subtree, restored before return
+     */
+    template<size_t DIM>
+    size_t rangeCount(Node *node, const Key &lo, const Key &hi, Cell &cell) {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (!node) return 0;
+        if (cellInBox(cell, lo, hi, std::index_sequence_for<KeyTypes...>())) return node->size;
+        size_t count = inBox(node->key(), lo, hi) ? 1 : 0;
+        const auto &split = std::get<DIM>(node->key());
+        if (!(split < std::get<DIM>(lo))) {
+            auto oldHi = std::get<DIM>(cell.hi);
+            bool oldHasHi = cell.hasHi[DIM];
+            std::get<DIM>(cell.hi) = split;
+            cell.hasHi[DIM] = true;
+            count += rangeCount<DIM_NEXT>(node->left, lo, hi, cell);
+            std::get<DIM>(cell.hi) = oldHi;
+            cell.hasHi[DIM] = oldHasHi;
+        }
+        if (!(std::get<DIM>(hi) < split)) {
+            auto oldLo = std::get<DIM>(cell.lo);
+            bool oldHasLo = cell.hasLo[DIM];
+            std::get<DIM>(cell.lo) = split;
+            cell.hasLo[DIM] = true;
+            count += rangeCount<DIM_NEXT>(node->right, lo, hi, cell);
+            std::get<DIM>(cell.lo) = oldLo;
+            cell.hasLo[DIM] = oldHasLo;
+        }
+        return count;
+    }
+
+    typedef std::pair<double, Node *> Candidate;
+    typedef std::priority_queue<Candidate> CandidateHeap;     // max-heap, the top is the worst candidate
+
+    /**
+     * Collect the k nearest nodes of key into a bounded max-heap
+     * A subtree on the far side of a splitting plane is skipped if the distance to the plane
+     * is larger than the current k-th best distance
+     * Time Complexity: O(k log n) expected for well distributed points
+     * @tparam DIM current dimension of node
+     * @tparam Metric see kdtree_metric.hpp
+     * @param node
+     * @param key
+     * @param count k, the number of neighbors
+     * @param heap
+     */
+    template<size_t DIM, typename Metric>
+    void knn(Node *node, const Key &key, size_t count, CandidateHeap &heap) {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (!node) return;
+        double dist = KDTreeMetric::distance<Metric>(key, node->key());
+        if (heap.size() < count) {
+            heap.emplace(dist, node);
+        } else if (dist < heap.top().first) {
+            heap.pop();
+            heap.emplace(dist, node);
+        }
+        double diff = (double) std::get<DIM>(key) - (double) std::get<DIM>(node->key());
+        Node *nearSide = diff < 0 ? node->left : node->right;
+        Node *farSide = diff < 0 ? node->right : node->left;
+        knn<DIM_NEXT, Metric>(nearSide, key, count, heap);
+        // points on the far side are at least |diff| away on this dimension
+        if (heap.size() < count || Metric::term(diff) <= heap.top().first) {
+            knn<DIM_NEXT, Metric>(farSide, key, count, heap);
+        }
+    }
+
 public:
     KDTree() = default;
 
@@ -411,12 +821,30 @@ public:
         if (v.empty()){
             return;
         }
-        destruct(root);
-        root=nullptr;
         std::stable_sort(v.begin(), v.end(), sortComp<0>);
         auto ip = std::unique(v.rbegin(), v.rend(), uniqueComp);
         v.erase(v.begin(), ip.base());
-        root = vectorConstruct<0>(nullptr, 0, (int)v.size()-1, v);
+        Node *nodes = arena.allocateBlock(v.size());
+        auto slots = [nodes](int i) -> void * { return nodes + i; };
+        root = vectorConstruct<0>(0, (int)v.size()-1, v, slots);
+        treeSize = v.size();
+    }
+
+    /**
+     * Build the tree with multiple threads, the result is identical to KDTree(v)
+     * Time complexity: O(kn log n / threads + kn)
+     * @param v we pass by value here because v need to be modified
+     * @param threads number of threads, 0 for std::thread::hardware_concurrency()
+     */
+    KDTree(std::vector<std::pair<Key, Value>> v, unsigned threads) {
+        if (v.empty()) return;
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = (unsigned) std::min((size_t) threads, v.size());
+        parallelSort(v, threads);
+        parallelUnique(v, threads);
+        Node *nodes = arena.allocateBlock(v.size());
+        auto slots = [nodes](int i) -> void * { return nodes + i; };
+        root = vectorConstructParallel<0>(0, (int) v.size() - 1, v, slots, threads);
         treeSize = v.size();
     }
 
@@ -426,9 +854,10 @@ public:
     KDTree(const KDTree &that) {
         // TODO: implement this function
         if(this==&that) return;
-        destruct(this->root);
-        this->root = copyFrom(nullptr, that.root);
+        this->root = copyFrom(that.root);
         this->treeSize = that.treeSize;
+        this->balanceFactor = that.balanceFactor;
+        this->maxTreeSize = that.maxTreeSize;
     }
 
     /**
@@ -437,26 +866,47 @@ public:
     KDTree &operator=(const KDTree &that) {
         // TODO: implement this function
         if(this==&that) return *this;
-        destruct(this->root);
-        this->root = copyFrom(nullptr, that.root);
+        destruct();
+        this->root = copyFrom(that.root);
         this->treeSize = that.treeSize;
+        this->balanceFactor = that.balanceFactor;
+        this->maxTreeSize = that.maxTreeSize;
         return *this;
     }
 
     /**
-     * Time complexity: O(n)
+     * Time complexity: O(1)
+     */
+    KDTree(KDTree &&that) noexcept {
+        swap(that);
+    }
+
+    /**
+     * Time complexity: O(n) to destroy the old tree, O(1) if Data is trivially destructible
+     */
+    KDTree &operator=(KDTree &&that) noexcept {
+        if(this==&that) return *this;
+        destruct();
+        swap(that);
+        return *this;
+    }
+
+    /**
+     * Time complexity: O(n), O(n / block size) if Data is trivially destructible
      */
     ~KDTree() {
         // TODO: implement this function
-        destruct(this->root);
-        this->treeSize = 0;
+        destruct();
     }
 
     Iterator begin() {
         if (!root) return end();
-        auto node = root;
-        while (node->left) node = node->left;
-        return Iterator(this, node);
+        Iterator it(this, root);
+        while (it.node->left) {
+            it.pushAncestor(it.node);
+            it.node = it.node->left;
+        }
+        return it;
     }
 
     Iterator end() {
@@ -464,52 +914,154 @@ public:
     }
 
     Iterator find(const Key &key) {
-        return Iterator(this, find<0>(key, root));
+        Iterator it(this, root);
+        for (size_t dim = 0; it.node && !(key == it.node->key()); dim = nextDim(dim)) {
+            it.pushAncestor(it.node);
+            it.node = compareKeyDynamic<std::less<>>(dim, key, it.node->key()) ? it.node->left : it.node->right;
+        }
+        return it.node ? it : end();
     }
 
     void insert(const Key &key, const Value &value) {
-        insert<0>(key, value, root, nullptr);
+        insert(key, value, root);
+        maxTreeSize = std::max(maxTreeSize, treeSize);
     }
 
     template<size_t DIM>
     Iterator findMin() {
-        return Iterator(this, findMin<DIM, 0>(root));
+        return Iterator(this, findMin<DIM>(root, 0));
     }
 
     Iterator findMin(size_t dim) {
-        return Iterator(this, findMinDynamic<0>(dim));
+        return Iterator(this, findMinDynamic(dim, root, 0));
     }
 
     template<size_t DIM>
     Iterator findMax() {
-        return Iterator(this, findMax<DIM, 0>(root));
+        return Iterator(this, findMax<DIM>(root, 0));
     }
 
     Iterator findMax(size_t dim) {
-        return Iterator(this, findMaxDynamic<0>(dim));
+        return Iterator(this, findMaxDynamic(dim, root, 0));
     }
 
     bool erase(const Key &key) {
-        auto prevSize = treeSize;
-        erase<0>(root, key);
-        return prevSize > treeSize;
+        bool erased = erase(root, key);
+        rebalanceAfterErase();
+        return erased;
     }
 
+    /**
+     * Time complexity: max{O(k log n), O(findMin)}
+     * @param it
+     * @return iterator of the element following the erased one
+     */
     Iterator erase(Iterator it) {
         if (it == end()) return it;
-        auto node = it.node;
-        if (!it.node->left && !it.node->right) {
-            it.node = it.node->parent;
+        Iterator next = it;
+        ++next;
+        if (next == end()) {
+            erase(it->first);
+            return end();
         }
-        size_t depth = 0;
-        auto temp = node->parent;
-        while (temp) {
-            temp = temp->parent;
-            ++depth;
+        // the erased node may take the key of its successor, so search for it again
+        Key nextKey = next->first;
+        erase(it->first);
+        return find(nextKey);
+    }
+
+    /**
+     * Visit all key-value pairs with lo <= key <= hi on every dimension, without allocation
+     * Time complexity: O(n^(1-1/k) + m) for a balanced tree, m is the number of reported pairs
+     * @param lo lower corner of the box (inclusive)
+     * @param hi upper corner of the box (inclusive)
+     * @param visitor called with Data & of every pair in the box
+     */
+    template<typename Visitor>
+    void rangeQuery(const Key &lo, const Key &hi, Visitor &&visitor) {
+        auto visit = [&visitor](Node *node) { visitor(node->data); };
+        rangeQuery<0>(root, lo, hi, visit);
+    }
+
+    /**
+     * Time complexity: O(n^(1-1/k) + m) for a balanced tree, m is the number of reported pairs
+     * @param lo lower corner of the box (inclusive)
+     * @param hi upper corner of the box (inclusive)
+     * @return pointers to all pairs in the box, valid until the tree is modified
+     */
+    std::vector<Data *> rangeQuery(const Key &lo, const Key &hi) {
+        std::vector<Data *> result;
+        auto visit = [&result](Node *node) { result.push_back(&node->data); };
+        rangeQuery<0>(root, lo, hi, visit);
+        return result;
+    }
+
+    /**
+     * Time complexity: O(n^(1-1/k)) for a balanced tree
+     * @param lo lower corner of the box (inclusive)
+     * @param hi upper corner of the box (inclusive)
+     * @return the number of keys in the box
+     */
+    size_t rangeCount(const Key &lo, const Key &hi) {
+        Cell cell{lo, hi, {}, {}};
+        return rangeCount<0>(root, lo, hi, cell);
+    }
+
+    /**
+     * Find the k nearest neighbors of key, the keys must be arithmetic
+     * Time complexity: O(k log n) expected for well distributed points, O(n) worst case
+     * @tparam Metric KDTreeMetric::L2 (default), KDTreeMetric::L1 or KDTreeMetric::LInf
+     * @param key
+     * @param count k, the number of neighbors
+     * @return pointers to the pairs of at most k nodes, sorted by ascending distance to key,
+     * valid until the tree is modified
+     */
+    template<typename Metric = KDTreeMetric::L2>
+    std::vector<Data *> knn(const Key &key, size_t count) {
+        std::vector<Data *> result;
+        if (count == 0) return result;
+        CandidateHeap heap;
+        knn<0, Metric>(root, key, count, heap);
+        result.reserve(heap.size());
+        for (; !heap.empty(); heap.pop()) result.push_back(&heap.top().second->data);
+        std::reverse(result.begin(), result.end());
+        return result;
+    }
+
+    /**
+     * Find the nearest neighbor of key, the keys must be arithmetic
+     * Time complexity: O(log n) expected for well distributed points, O(n) worst case
+     * @tparam Metric KDTreeMetric::L2 (default), KDTreeMetric::L1 or KDTreeMetric::LInf
+     * @param key
+     * @return iterator of the nearest node, or end() if the tree is empty
+     */
+    template<typename Metric = KDTreeMetric::L2>
+    Iterator nearest(const Key &key) {
+        if (!root) return end();
+        CandidateHeap heap;
+        knn<0, Metric>(root, key, 1, heap);
+        return Iterator(this, heap.top().second);
+    }
+
+    /**
+     * Enable scapegoat rebalancing, keeping the depth O(log n) under any sequence of updates
+     * After an insertion deeper than log_{1/alpha}(n), the deepest ancestor with a child holding more than
+     * alpha of its nodes is rebuilt; after erasures leave less than alpha of the maximum size, the whole tree is
+     * rebuilt
+     * Time complexity: O(kn log n) for the initial rebuild
+     * @throw std::range_error if alpha is neither 0 (disabled, the default) nor in [0.5, 1)
+     * @param alpha
+     */
+    void setBalanceFactor(double alpha) {
+        if (alpha != 0 && (alpha < 0.5 || alpha >= 1)) {
+            throw std::range_error("invalid balance factor!");
         }
-        eraseDynamic<0>(node, depth % KeySize);
-        return it;
+        balanceFactor = alpha;
+        maxTreeSize = treeSize;
+        if (balanceFactor > 0 && root) root = rebuild(root, 0);
     }
 
+    double getBalanceFactor() const { return balanceFactor; }
+
     size_t size() const { return treeSize; }
 };
@@ -0,0 +1,88 @@
+#ifndef VE281P3_KDTREE_FILE_HPP
+#define VE281P3_KDTREE_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * On-disk format of a serialized StaticKDTree, opened with mmap
+ * [Header][type signature][padding][keys][padding][values], every array starts at a multiple of ALIGNMENT,
+ * so queries can read the mapped pages in place without any deserialization
+ * The type signature describes std::tuple<KeyTypes...> and Value, e.g. "i4,i4,f8:u8",
+ * a file is only opened as a tree of exactly the same types
+ */
+namespace KDTreeFile {
+    inline constexpr char MAGIC[8] = {'V', 'E', '2', '8', '1', 'K', 'D', 'T'};
+    inline constexpr uint32_t VERSION = 1;
+    inline constexpr uint32_t ENDIAN_MARK = 0x01020304;   // reads differently on a machine of the other endianness
+    inline constexpr size_t ALIGNMENT = 64;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t keySize;           // number of dimensions
+        uint64_t packed;            // 1 if keys are packed per node, 0 if stored per dimension
+        uint64_t treeSize;
+        uint64_t signatureSize;     // length of the type signature following the header
+        uint64_t fileSize;
+    };
+
+    inline size_t alignUp(size_t offset) {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    /**
+     * Signature of one trivially copyable type: kind and size for arithmetic types (i4 for int32_t, f8 for double),
+     * size and alignment for others (r12.4 for a struct of three ints)
+     */
+    template<typename T>
+    std::string typeSignature() {
+        static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable types can be mapped");
+        std::string size = std::to_string(sizeof(T));
+        if constexpr (std::is_same<T, bool>::value) return "b" + size;
+        else if constexpr (std::is_floating_point<T>::value) return "f" + size;
+        else if constexpr (std::is_integral<T>::value) return (std::is_signed<T>::value ? "i" : "u") + size;
+        else return "r" + size + "." + std::to_string(alignof(T));
+    }
+
+    template<typename Value, typename... KeyTypes>
+    std::string signature() {
+        std::string result;
+        ((result += (result.empty() ? "" : ",") + typeSignature<KeyTypes>()), ...);
+        return result + ":" + typeSignature<Value>();
+    }
+
+    /**
+     * Map a whole file privately: pages are shared with every other process mapping the same file through
+     * the page cache, and a write only copies the page it touches
+     * @throw std::runtime_error if the file can not be opened or mapped
+     * @return the mapping, unmapped when the last copy of the pointer is destroyed
+     */
+    inline std::shared_ptr<char> map(const std::string &path, size_t &size) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("can not open " + path);
+        struct stat status{};
+        if (fstat(fd, &status) != 0 || status.st_size == 0) {
+            close(fd);
+            throw std::runtime_error("can not read " + path);
+        }
+        size = (size_t) status.st_size;
+        void *address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (address == MAP_FAILED) throw std::runtime_error("can not map " + path);
+        return std::shared_ptr<char>((char *) address, [size](char *address) { munmap(address, size); });
+    }
+}
+
+#endif //VE281P3_KDTREE_FILE_HPP
@@ -0,0 +1,120 @@
+#ifndef VE281P3_KDTREE_KERNEL_HPP
+#define VE281P3_KDTREE_KERNEL_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "kdtree_metric.hpp"
+
+/**
+ * Distance and box kernels over packed keys
+ * A key std::tuple<T, T, ..., T> of one arithmetic type T is packed into std::array<T, k>;
+ * every kernel is a loop with the compile-time trip count k and no branches in its body,
+ * so the compiler fully unrolls and vectorizes it (at -O3, or -O2 -ftree-vectorize on older compilers)
+ * Keys of mixed types are not packable and keep using the per-dimension std::get path
+ */
+namespace KDTreeKernel {
+    template<typename Key>
+    struct Packing {
+        static constexpr bool packable = false;
+    };
+
+    template<typename T, typename... Ts>
+    struct Packing<std::tuple<T, Ts...>> {
+        static constexpr bool packable = std::is_arithmetic<T>::value && (std::is_same<T, Ts>::value && ...);
+        typedef T Scalar;
+        typedef std::array<T, 1 + sizeof...(Ts)> Packed;
+    };
+
+    /**
+     * Whether Key is a tuple of one arithmetic type
+     */
+    template<typename Key>
+    inline constexpr bool isPackable = Packing<Key>::packable;
+
+    template<typename Key>
+    using Packed = typename Packing<Key>::Packed;
+
+    template<typename Key, size_t... DIMS>
+    Packed<Key> pack(const Key &key, std::index_sequence<DIMS...>) {
+        return {std::get<DIMS>(key)...};
+    }
+
+    template<typename Key>
+    Packed<Key> pack(const Key &key) {
+        return pack(key, std::make_index_sequence<std::tuple_size<Key>::value>());
+    }
+
+    template<typename Key, typename T, size_t K, size_t... DIMS>
+    Key unpack(const std::array<T, K> &point, std::index_sequence<DIMS...>) {
+        return Key(point[DIMS]...);
+    }
+
+    template<typename Key, typename T, size_t K>
+    Key unpack(const std::array<T, K> &point) {
+        return unpack<Key>(point, std::make_index_sequence<K>());
+    }
+
+    /**
+     * Time Complexity: O(k), one vector operation for small k
+     * @return the distance between two points in the internal unit of Metric
+     */
+    template<typename Metric, typename T, size_t K>
+    double distance(const std::array<T, K> &a, const std::array<T, K> &b) {
+        double acc = 0;
+        for (size_t d = 0; d < K; d++) acc = Metric::combine(acc, Metric::term((double) a[d] - (double) b[d]));
+        return acc;
+    }
+
+    /**
+     * Time Complexity: O(k), without branches
+     * @return whether lo <= point <= hi on every dimension
+     */
+    template<typename T, size_t K>
+    bool inBox(const std::array<T, K> &point, const std::array<T, K> &lo, const std::array<T, K> &hi) {
+        bool inside = true;
+        for (size_t d = 0; d < K; d++) inside &= (lo[d] <= point[d]) & (point[d] <= hi[d]);
+        return inside;
+    }
+
+    /**
+     * Brute force nearest neighbor over contiguous points, e.g. a leaf bucket
+     * The distance of each point is one vector operation, and the running minimum is kept with selects
+     * instead of branches, which are mispredicted often on short scans
+     * Time Complexity: O(kn)
+     * @param points
+     * @param count number of points
+     * @param query
+     * @param bestDist the bound to beat, updated to the distance of the returned point
+     * @return index of the nearest point closer than bestDist, or count if there is none
+     */
+    template<typename Metric, typename T, size_t K>
+    size_t nearest(const std::array<T, K> *points, size_t count, const std::array<T, K> &query, double &bestDist) {
+        size_t best = count;
+        for (size_t i = 0; i < count; i++) {
+            double dist = distance<Metric>(points[i], query);
+            bool better = dist < bestDist;
+            bestDist = better ? dist : bestDist;
+            best = better ? i : best;
+        }
+        return best;
+    }
+
+    /**
+     * Time Complexity: O(kn), without branches
+     * @return the number of contiguous points with lo <= point <= hi on every dimension
+     */
+    template<typename T, size_t K>
+    size_t countInBox(const std::array<T, K> *points, size_t count, const std::array<T, K> &lo,
+                      const std::array<T, K> &hi) {
+        size_t result = 0;
+        for (size_t i = 0; i < count; i++) result += inBox(points[i], lo, hi);
+        return result;
+    }
+}
+
+#endif //VE281P3_KDTREE_KERNEL_HPP
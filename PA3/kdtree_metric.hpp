@@ -0,0 +1,70 @@
+#ifndef VE281P3_KDTREE_METRIC_HPP
+#define VE281P3_KDTREE_METRIC_HPP
+
+#include <tuple>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+
+/**
+ * Distance metrics for nearest neighbor queries on tuple keys
+ * A metric turns the difference on one dimension into a term and combines the terms of all dimensions,
+ * the loop over the dimensions of std::tuple<KeyTypes...> is unrolled at compile time
+ * Distances are compared in the metric's internal unit (e.g. squared distance for L2);
+ * finish converts an internal distance to the real one
+ * A single term is a lower bound of the distance to any point on the other side of a splitting plane,
+ * which is what the kd-tree uses for pruning
+ */
+namespace KDTreeMetric {
+    /**
+     * Euclidean distance, internally the squared distance
+     */
+    struct L2 {
+        static double term(double diff) { return diff * diff; }
+
+        static double combine(double acc, double term) { return acc + term; }
+
+        static double finish(double dist) { return std::sqrt(dist); }
+    };
+
+    /**
+     * Manhattan distance
+     */
+    struct L1 {
+        static double term(double diff) { return std::fabs(diff); }
+
+        static double combine(double acc, double term) { return acc + term; }
+
+        static double finish(double dist) { return dist; }
+    };
+
+    /**
+     * Chebyshev distance
+     */
+    struct LInf {
+        static double term(double diff) { return std::fabs(diff); }
+
+        static double combine(double acc, double term) { return std::max(acc, term); }
+
+        static double finish(double dist) { return dist; }
+    };
+
+    template<typename Metric, typename Key, size_t... DIMS>
+    double distance(const Key &a, const Key &b, std::index_sequence<DIMS...>) {
+        double acc = 0;
+        ((acc = Metric::combine(acc, Metric::term((double) std::get<DIMS>(a) - (double) std::get<DIMS>(b)))), ...);
+        return acc;
+    }
+
+    /**
+     * Time Complexity: O(k)
+     * @return the distance between two keys in the internal unit of Metric
+     */
+    template<typename Metric, typename Key>
+    double distance(const Key &a, const Key &b) {
+        return distance<Metric>(a, b, std::make_index_sequence<std::tuple_size<Key>::value>());
+    }
+}
+
+#endif //VE281P3_KDTREE_METRIC_HPP
@@ -0,0 +1,128 @@
+#ifndef VE281P3_NODE_ARENA_HPP
+#define VE281P3_NODE_ARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * A slab allocator for the nodes of one tree
+ * Nodes are carved out of large blocks, freed nodes are kept on a free list for reuse,
+ * and all blocks are released at once without visiting the nodes
+ * The arena only hands out uninitialized memory: the owner constructs nodes with placement new,
+ * and must destroy them itself if T is not trivially destructible
+ * @tparam T node type
+ */
+template<typename T>
+class NodeArena {
+public:
+    static constexpr size_t MIN_BLOCK = 64;             // nodes in the first block
+    static constexpr size_t MAX_BLOCK = 1 << 16;        // blocks grow geometrically up to this size
+
+private:
+    struct Block {
+        T *nodes;
+        size_t capacity;
+    };
+
+    struct FreeSlot {
+        FreeSlot *next;
+    };
+
+    static_assert(sizeof(T) >= sizeof(FreeSlot), "node is too small for the free list");
+
+    std::vector<Block> blocks;
+    T *bump = nullptr;                  // next unused node of the current block
+    T *bumpEnd = nullptr;
+    FreeSlot *freeList = nullptr;
+    size_t totalCapacity = 0;
+
+    T *newBlock(size_t capacity) {
+        blocks.reserve(blocks.size() + 1);
+        T *nodes = std::allocator<T>().allocate(capacity);
+        blocks.push_back({nodes, capacity});
+        totalCapacity += capacity;
+        return nodes;
+    }
+
+public:
+    NodeArena() = default;
+
+    NodeArena(const NodeArena &) = delete;
+
+    NodeArena &operator=(const NodeArena &) = delete;
+
+    NodeArena(NodeArena &&that) noexcept { swap(that); }
+
+    NodeArena &operator=(NodeArena &&that) noexcept {
+        NodeArena temp(std::move(that));
+        swap(temp);
+        return *this;
+    }
+
+    ~NodeArena() { release(); }
+
+    void swap(NodeArena &that) noexcept {
+        std::swap(blocks, that.blocks);
+        std::swap(bump, that.bump);
+        std::swap(bumpEnd, that.bumpEnd);
+        std::swap(freeList, that.freeList);
+        std::swap(totalCapacity, that.totalCapacity);
+    }
+
+    /**
+     * Memory for one node, from the free list first
+     * Time complexity: O(1) amortized
+     */
+    void *allocate() {
+        if (freeList) {
+            void *slot = freeList;
+            freeList = freeList->next;
+            return slot;
+        }
+        if (bump == bumpEnd) {
+            size_t capacity = std::min(std::max(MIN_BLOCK, totalCapacity), MAX_BLOCK);
+            bump = newBlock(capacity);
+            bumpEnd = bump + capacity;
+        }
+        return bump++;
+    }
+
+    /**
+     * Contiguous memory for count nodes in a dedicated block, the current block stays in use
+     * Time complexity: O(1)
+     */
+    T *allocateBlock(size_t count) {
+        return count ? newBlock(count) : nullptr;
+    }
+
+    /**
+     * Destroy a node and put its memory on the free list
+     * Time complexity: O(1)
+     */
+    void deallocate(T *node) {
+        node->~T();
+        freeList = new(static_cast<void *>(node)) FreeSlot{freeList};
+    }
+
+    /**
+     * Release all blocks, the nodes must have been destroyed or be trivially destructible
+     * Time complexity: O(number of blocks)
+     */
+    void release() {
+        for (auto &block : blocks) std::allocator<T>().deallocate(block.nodes, block.capacity);
+        blocks.clear();
+        bump = bumpEnd = nullptr;
+        freeList = nullptr;
+        totalCapacity = 0;
+    }
+
+    /**
+     * @return number of nodes the blocks can hold
+     */
+    size_t capacity() const { return totalCapacity; }
+};
+
+#endif //VE281P3_NODE_ARENA_HPP
@@ -0,0 +1,622 @@
+#ifndef VE281P3_STATIC_KDTREE_HPP
+#define VE281P3_STATIC_KDTREE_HPP
+
+#include <tuple>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "kdtree_file.hpp"
+#include "kdtree_kernel.hpp"
+#include "kdtree_metric.hpp"
+
+/**
+ * An abstract template base of the StaticKDTree class
+ */
+template<typename...>
+class StaticKDTree;
+
+/**
+ * A read-only KDTree bulk loaded from a vector, stored without pointers
+ * Nodes are laid out in implicit (Eytzinger) order: the root is at index 0,
+ * the children of node i are at 2i+1 and 2i+2, and node i splits on dimension depth(i) % k.
+ * The tree is left-balanced (complete), so the n nodes occupy exactly indices [0, n)
+ * Keys are stored separately from the values: a key of one arithmetic type (e.g. std::tuple<float, float, float>)
+ * is packed into one std::array per node, so distances and box tests run as vectorized kernels (kdtree_kernel.hpp);
+ * other keys are stored in SoA form, one contiguous array per dimension
+ * A tree of trivially copyable keys and values can be saved to a file and loaded back with mmap (kdtree_file.hpp);
+ * queries then run directly on the mapped pages, which processes mapping the same file share
+ * The time complexity of functions are based on n and k
+ * n is the size of the KDTree
+ * k is the number of dimensions
+ * @typedef Key         key type
+ * @typedef Value       value type
+ * @static  KeySize     k (number of dimensions)
+ */
+template<typename ValueType, typename... KeyTypes>
+class StaticKDTree<std::tuple<KeyTypes...>, ValueType> {
+public:
+    typedef std::tuple<KeyTypes...> Key;
+    typedef ValueType Value;
+    static inline constexpr size_t KeySize = std::tuple_size<Key>::value;
+    static inline constexpr size_t npos = static_cast<size_t>(-1);
+    static_assert(KeySize > 0, "Can not construct StaticKDTree with zero dimension");
+    static inline constexpr bool Packed = KDTreeKernel::isPackable<Key>;
+
+protected:
+    typedef KDTreeKernel::Packed<Key> PackedKey;
+    typedef std::conditional_t<Packed, std::vector<PackedKey>, std::tuple<std::vector<KeyTypes>...>> KeyStorage;
+    typedef std::conditional_t<Packed, const PackedKey *, std::tuple<const KeyTypes *...>> KeyView;
+
+    // a built tree owns its arrays, a loaded tree leaves them empty and views the mapped file instead
+    KeyStorage keys;                            // keys[i][DIM] if Packed, else std::get<DIM>(keys)[i]
+    std::vector<Value> values;                  // values[i] is the value of node i
+    KeyView keyData{};                          // the keys queries read, in the same layout as keys
+    Value *valueData = nullptr;                 // the values queries read
+    std::shared_ptr<char> mapping;              // the mapped file of a loaded tree
+    size_t treeSize = 0;                        // size of the tree
+
+    static size_t left(size_t index) { return 2 * index + 1; }
+
+    static size_t right(size_t index) { return 2 * index + 2; }
+
+    template<size_t DIM>
+    const auto &coordAt(size_t index) const {
+        if constexpr (Packed) return keyData[index][DIM];
+        else return std::get<DIM>(keyData)[index];
+    }
+
+    template<size_t... DIMS>
+    Key keyAt(size_t index, std::index_sequence<DIMS...>) const {
+        return Key(coordAt<DIMS>(index)...);
+    }
+
+    void resizeKeys(size_t size) {
+        if constexpr (Packed) keys.resize(size);
+        else std::apply([size](auto &...dims) { (dims.resize(size), ...); }, keys);
+    }
+
+    void bindViews() {
+        if constexpr (Packed) keyData = keys.data();
+        else keyData = std::apply([](const auto &...dims) { return KeyView(dims.data()...); }, keys);
+        valueData = values.data();
+    }
+
+    template<size_t... DIMS>
+    void store(size_t index, const Key &key, std::index_sequence<DIMS...>) {
+        if constexpr (Packed) keys[index] = KDTreeKernel::pack(key);
+        else ((std::get<DIMS>(keys)[index] = std::get<DIMS>(key)), ...);
+    }
+
+    /**
+     * Compare a key with node index on a dimension, ties broken by the whole key
+     * Time Complexity: O(1)
+     * @tparam DIM comparison dimension
+     * @tparam Compare
+     * @return compare(key, key of node index) with the order used to build the tree
+     */
+    template<size_t DIM, typename Compare>
+    bool compareWithNode(const Key &key, size_t index, Compare compare = Compare()) const {
+        const auto &coord = coordAt<DIM>(index);
+        if (std::get<DIM>(key) != coord) return compare(std::get<DIM>(key), coord);
+        return compare(key, this->key(index));
+    }
+
+    template<size_t DIM, typename Compare>
+    static bool compareKey(const Key &a, const Key &b, Compare compare = Compare()) {
+        if (std::get<DIM>(a) != std::get<DIM>(b)) {
+            return compare(std::get<DIM>(a), std::get<DIM>(b));
+        }
+        return compare(a, b);
+    }
+
+    template<size_t DIM>
+    static bool sortComp(const std::pair<Key, Value> &a, const std::pair<Key, Value> &b) {
+        return compareKey<DIM, std::less<>>(a.first, b.first);
+    }
+
+    static bool uniqueComp(const std::pair<Key, Value> &a, const std::pair<Key, Value> &b) {
+        return a.first == b.first;
+    }
+
+    /**
+     * Size of the left subtree of a left-balanced tree with n nodes
+     * Time Complexity: O(log n)
+     */
+    static size_t leftSubtreeSize(size_t n) {
+        if (n <= 1) return 0;
+        size_t full = 1;                            // 2^h, h is the height of the tree
+        while (full * 2 <= n) full *= 2;
+        size_t half = full / 2;                     // capacity of the last level of the left subtree
+        size_t lastLevel = n - (full - 1);
+        return (half - 1) + std::min(lastLevel, half);
+    }
+
+    /**
+     * Build the subtree rooted at index from v[first, last)
+     * Time Complexity: O(n log n)
+     * @tparam DIM splitting dimension of index
+     */
+    template<size_t DIM>
+    void build(size_t index, size_t first, size_t last, std::vector<std::pair<Key, Value>> &v) {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (first >= last) return;
+        size_t mid = first + leftSubtreeSize(last - first);
+        std::nth_element(v.begin() + first, v.begin() + mid, v.begin() + last, sortComp<DIM>);
+        store(index, v[mid].first, std::index_sequence_for<KeyTypes...>());
+        values[index] = v[mid].second;
+        build<DIM_NEXT>(left(index), first, mid, v);
+        build<DIM_NEXT>(right(index), mid + 1, last, v);
+    }
+
+    /**
+     * Time Complexity: O(k log n)
+     * @tparam DIM splitting dimension of index
+     * @return the node index with key, or npos if not found
+     */
+    template<size_t DIM>
+    size_t find(const Key &key, size_t index) const {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (index >= treeSize) return npos;
+        if (compareWithNode<DIM, std::less<>>(key, index)) return find<DIM_NEXT>(key, left(index));
+        if (compareWithNode<DIM, std::greater<>>(key, index)) return find<DIM_NEXT>(key, right(index));
+        return index;
+    }
+
+    template<size_t DIM_CMP, typename Compare>
+    size_t compareIndex(size_t a, size_t b) const {
+        if (a == npos) return b;
+        if (b == npos) return a;
+        return compareWithNode<DIM_CMP, Compare>(key(a), b) ? a : b;
+    }
+
+    /**
+     * Find the minimum node on a dimension
+     * Time Complexity: O(n^(1-1/k))
+     * @tparam DIM_CMP comparison dimension
+     * @tparam DIM splitting dimension of index
+     */
+    template<size_t DIM_CMP, size_t DIM>
+    size_t findMin(size_t index) const {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (index >= treeSize) return npos;
+        size_t min = findMin<DIM_CMP, DIM_NEXT>(left(index));
+        if (DIM_CMP != DIM) {
+            min = compareIndex<DIM_CMP, std::less<>>(min, findMin<DIM_CMP, DIM_NEXT>(right(index)));
+        }
+        return compareIndex<DIM_CMP, std::less<>>(index, min);
+    }
+
+    /**
+     * Find the maximum node on a dimension
+     * Time Complexity: O(n^(1-1/k))
+     * @tparam DIM_CMP comparison dimension
+     * @tparam DIM splitting dimension of index
+     */
+    template<size_t DIM_CMP, size_t DIM>
+    size_t findMax(size_t index) const {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (index >= treeSize) return npos;
+        size_t max = findMax<DIM_CMP, DIM_NEXT>(right(index));
+        if (DIM_CMP != DIM) {
+            max = compareIndex<DIM_CMP, std::greater<>>(max, findMax<DIM_CMP, DIM_NEXT>(left(index)));
+        }
+        return compareIndex<DIM_CMP, std::greater<>>(index, max);
+    }
+
+    template<size_t DIM>
+    size_t findMinDynamic(size_t dim) const {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (dim >= KeySize) {
+            dim %= KeySize;
+        }
+        if (dim == DIM) return findMin<DIM, 0>(0);
+        return findMinDynamic<DIM_NEXT>(dim);
+    }
+
+    template<size_t DIM>
+    size_t findMaxDynamic(size_t dim) const {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (dim >= KeySize) {
+            dim %= KeySize;
+        }
+        if (dim == DIM) return findMax<DIM, 0>(0);
+        return findMaxDynamic<DIM_NEXT>(dim);
+    }
+
+    template<typename Metric, size_t... DIMS>
+    double distanceTo(const Key &key, size_t index, std::index_sequence<DIMS...>) const {
+        if constexpr (Packed) {
+            return KDTreeKernel::distance<Metric>(KDTreeKernel::pack(key), keyData[index]);
+        } else {
+            double acc = 0;
+            ((acc = Metric::combine(acc, Metric::term((double) std::get<DIMS>(key) - (double) coordAt<DIMS>(index)))), ...);
+            return acc;
+        }
+    }
+
+    /**
+     * Branch-and-bound nearest neighbor search
+     * Time Complexity: O(log n) expected for well distributed points
+     * @tparam DIM splitting dimension of index
+     * @param best the best node so far, may be seeded with any node to give an initial bound
+     * @param bestDist distance from key to best in the internal unit of Metric
+     */
+    template<size_t DIM, typename Metric>
+    void nearest(const Key &key, size_t index, size_t &best, double &bestDist) const {
+        constexpr size_t DIM_NEXT = (DIM + 1) % KeySize;
+        if (index >= treeSize) return;
+        double dist = distanceTo<Metric>(key, index, std::index_sequence_for<KeyTypes...>());
+        if (dist < bestDist) {
+            bestDist = dist;
+            best = index;
+        }
+        double diff = (double) std::get<DIM>(key) - (double) coordAt<DIM>(index);
+        size_t nearSide = diff < 0 ? left(index) : right(index);
+        size_t farSide = diff < 0 ? right(index) : left(index);
+        nearest<DIM_NEXT, Metric>(key, nearSide, best, bestDist);
+        if (Metric::term(diff) < bestDist) nearest<DIM_NEXT, Metric>(key, farSide, best, bestDist);
+    }
+
+    // bits per dimension of the Morton code
+    static constexpr unsigned MORTON_BITS = 64 / KeySize >= 21 ? 21 : (64 / KeySize > 0 ? 64 / KeySize : 1);
+
+    template<size_t... DIMS>
+    static void expand(std::vector<double> &lo, std::vector<double> &hi, const Key &key, std::index_sequence<DIMS...>) {
+        ((lo[DIMS] = std::min(lo[DIMS], (double) std::get<DIMS>(key)),
+          hi[DIMS] = std::max(hi[DIMS], (double) std::get<DIMS>(key))), ...);
+    }
+
+    template<size_t... DIMS>
+    static uint64_t mortonCode(const std::vector<double> &lo, const std::vector<double> &scale, const Key &key,
+                               std::index_sequence<DIMS...>) {
+        uint64_t cells[KeySize] = {(uint64_t) (((double) std::get<DIMS>(key) - lo[DIMS]) * scale[DIMS])...};
+        uint64_t code = 0;
+        for (unsigned bit = MORTON_BITS; bit-- > 0;) {
+            for (size_t d = 0; d < KeySize && d * MORTON_BITS < 64; d++) code = (code << 1) | ((cells[d] >> bit) & 1);
+        }
+        return code;
+    }
+
+    /**
+     * Order of the queries along a Z-order (Morton) curve over their bounding box
+     * Consecutive queries in this order are close in space and visit mostly the same nodes
+     * Time Complexity: O(q log q) for q queries
+     */
+    static std::vector<size_t> spatialOrder(const std::vector<Key> &queries) {
+        std::vector<double> lo(KeySize, std::numeric_limits<double>::infinity());
+        std::vector<double> hi(KeySize, -std::numeric_limits<double>::infinity());
+        for (const auto &query : queries) expand(lo, hi, query, std::index_sequence_for<KeyTypes...>());
+        std::vector<double> scale(KeySize);
+        for (size_t d = 0; d < KeySize; d++) {
+            scale[d] = hi[d] > lo[d] ? (double) ((1ull << MORTON_BITS) - 1) / (hi[d] - lo[d]) : 0;
+        }
+        std::vector<std::pair<uint64_t, size_t>> codes(queries.size());
+        for (size_t i = 0; i < queries.size(); i++) {
+            codes[i] = {mortonCode(lo, scale, queries[i], std::index_sequence_for<KeyTypes...>()), i};
+        }
+        std::sort(codes.begin(), codes.end());
+        std::vector<size_t> order(queries.size());
+        for (size_t i = 0; i < queries.size(); i++) order[i] = codes[i].second;
+        return order;
+    }
+
+    /**
+     * Run handle(query index, state) for all queries in spatial order, split into contiguous runs across threads
+     * state is carried from one query to the next within a run, it starts from 0
+     * @param threads number of threads, 0 for std::thread::hardware_concurrency()
+     */
+    template<typename Handle>
+    static void runBatch(const std::vector<Key> &queries, unsigned threads, Handle handle) {
+        std::vector<size_t> order = spatialOrder(queries);
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = (unsigned) std::max<size_t>(1, std::min<size_t>(threads, queries.size() / 256));
+        auto work = [&](size_t t) {
+            size_t first = order.size() * t / threads, last = order.size() * (t + 1) / threads;
+            size_t state = 0;
+            for (size_t i = first; i < last; i++) handle(order[i], state);
+        };
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < threads; t++) workers.emplace_back(work, t);
+        work(0);
+        for (auto &worker : workers) worker.join();
+    }
+
+    /**
+     * Offsets of the key arrays (one if Packed, else one per dimension) and the value array in a file,
+     * followed by the file size
+     */
+    static std::vector<size_t> fileLayout(size_t size, size_t signatureSize) {
+        std::vector<size_t> offsets;
+        size_t offset = KDTreeFile::alignUp(sizeof(KDTreeFile::Header) + signatureSize);
+        auto add = [&](size_t bytes) {
+            offsets.push_back(offset);
+            offset = KDTreeFile::alignUp(offset + bytes);
+        };
+        if constexpr (Packed) add(size * sizeof(PackedKey));
+        else (add(size * sizeof(KeyTypes)), ...);
+        add(size * sizeof(Value));
+        offsets.push_back(offset);
+        return offsets;
+    }
+
+    template<size_t... DIMS>
+    void bindFile(const std::vector<size_t> &offsets, std::index_sequence<DIMS...>) {
+        char *base = mapping.get();
+        if constexpr (Packed) keyData = reinterpret_cast<const PackedKey *>(base + offsets[0]);
+        else keyData = KeyView(reinterpret_cast<const KeyTypes *>(base + offsets[DIMS])...);
+        valueData = reinterpret_cast<Value *>(base + offsets[offsets.size() - 2]);
+    }
+
+public:
+    StaticKDTree() = default;
+
+    /**
+     * Same semantics as the KDTree constructor: if a key appears more than once, the last value is kept
+     * Time complexity: O(kn log n)
+     * @param v we pass by value here because v need to be modified
+     */
+    explicit StaticKDTree(std::vector<std::pair<Key, Value>> v) {
+        if (v.empty()) return;
+        std::stable_sort(v.begin(), v.end(), sortComp<0>);
+        auto ip = std::unique(v.rbegin(), v.rend(), uniqueComp);
+        v.erase(v.begin(), ip.base());
+        treeSize = v.size();
+        resizeKeys(treeSize);
+        values.resize(treeSize);
+        build<0>(0, 0, treeSize, v);
+        bindViews();
+    }
+
+    /**
+     * A copy of a loaded tree reads the mapped file into arrays of its own, since values can be written
+     * Time complexity: O(n)
+     */
+    StaticKDTree(const StaticKDTree &that) : keys(that.keys), values(that.values), treeSize(that.treeSize) {
+        if (that.mapping) {
+            if constexpr (Packed) keys.assign(that.keyData, that.keyData + treeSize);
+            else {
+                std::apply([&](auto &...dims) {
+                    std::apply([&](auto... views) { (dims.assign(views, views + treeSize), ...); }, that.keyData);
+                }, keys);
+            }
+            values.assign(that.valueData, that.valueData + treeSize);
+        }
+        bindViews();
+    }
+
+    StaticKDTree(StaticKDTree &&that) noexcept {
+        swap(that);
+    }
+
+    StaticKDTree &operator=(StaticKDTree that) noexcept {
+        swap(that);
+        return *this;
+    }
+
+    void swap(StaticKDTree &that) noexcept {
+        std::swap(keys, that.keys);
+        std::swap(values, that.values);
+        std::swap(keyData, that.keyData);
+        std::swap(valueData, that.valueData);
+        std::swap(mapping, that.mapping);
+        std::swap(treeSize, that.treeSize);
+    }
+
+    /**
+     * Time complexity: O(k)
+     * @return the key of node index
+     */
+    Key key(size_t index) const {
+        return keyAt(index, std::index_sequence_for<KeyTypes...>());
+    }
+
+    /**
+     * Time complexity: O(1)
+     * @return dimension DIM of the key of node index
+     */
+    template<size_t DIM>
+    const auto &coord(size_t index) const {
+        return coordAt<DIM>(index);
+    }
+
+    const Value &value(size_t index) const { return valueData[index]; }
+
+    /**
+     * Writing a value of a loaded tree only changes the private copy of its page, not the file
+     */
+    Value &value(size_t index) { return valueData[index]; }
+
+    /**
+     * Time complexity: O(k log n)
+     * @return the node index with key, or npos if not found
+     */
+    size_t findIndex(const Key &key) const {
+        return find<0>(key, 0);
+    }
+
+    /**
+     * Time complexity: O(k log n)
+     * @return pointer to the value of key, or nullptr if not found
+     */
+    const Value *find(const Key &key) const {
+        size_t index = findIndex(key);
+        return index == npos ? nullptr : &valueData[index];
+    }
+
+    bool contains(const Key &key) const {
+        return findIndex(key) != npos;
+    }
+
+    /**
+     * @return the node index of the minimum key on dimension DIM, or npos if the tree is empty
+     */
+    template<size_t DIM>
+    size_t findMin() const {
+        return findMin<DIM, 0>(0);
+    }
+
+    size_t findMin(size_t dim) const {
+        return findMinDynamic<0>(dim);
+    }
+
+    /**
+     * @return the node index of the maximum key on dimension DIM, or npos if the tree is empty
+     */
+    template<size_t DIM>
+    size_t findMax() const {
+        return findMax<DIM, 0>(0);
+    }
+
+    size_t findMax(size_t dim) const {
+        return findMaxDynamic<0>(dim);
+    }
+
+    /**
+     * Find the nearest neighbor of key, the keys must be arithmetic
+     * Time complexity: O(log n) expected for well distributed points, O(n) worst case
+     * @tparam Metric KDTreeMetric::L2 (default), KDTreeMetric::L1 or KDTreeMetric::LInf
+     * @return the node index of the nearest key, or npos if the tree is empty
+     */
+    template<typename Metric = KDTreeMetric::L2>
+    size_t nearest(const Key &key) const {
+        size_t best = npos;
+        double bestDist = std::numeric_limits<double>::infinity();
+        nearest<0, Metric>(key, 0, best, bestDist);
+        return best;
+    }
+
+    /**
+     * Find many keys at once
+     * Queries are sorted along a space-filling curve for cache locality and spread across threads
+     * Time complexity: O(q k log n / threads + q log q) for q queries
+     * @param queries
+     * @param threads number of threads, 0 for std::thread::hardware_concurrency()
+     * @return the node index of every query (npos if not found), in input order
+     */
+    std::vector<size_t> findBatch(const std::vector<Key> &queries, unsigned threads = 0) const {
+        std::vector<size_t> result(queries.size(), npos);
+        runBatch(queries, threads, [&](size_t i, size_t &) { result[i] = findIndex(queries[i]); });
+        return result;
+    }
+
+    /**
+     * Find the nearest neighbors of many keys at once
+     * Queries are sorted along a space-filling curve for cache locality and spread across threads;
+     * the answer of the previous query seeds the bound of the next one, which prunes most of the tree early
+     * Time complexity: O(q log n / threads + q log q) expected for q well distributed queries
+     * @tparam Metric KDTreeMetric::L2 (default), KDTreeMetric::L1 or KDTreeMetric::LInf
+     * @param queries
+     * @param threads number of threads, 0 for std::thread::hardware_concurrency()
+     * @return the node index of the nearest key of every query (npos if the tree is empty), in input order
+     */
+    template<typename Metric = KDTreeMetric::L2>
+    std::vector<size_t> nearestBatch(const std::vector<Key> &queries, unsigned threads = 0) const {
+        std::vector<size_t> result(queries.size(), npos);
+        if (treeSize == 0) return result;
+        runBatch(queries, threads, [&](size_t i, size_t &previous) {
+            size_t best = previous;
+            double bestDist = distanceTo<Metric>(queries[i], best, std::index_sequence_for<KeyTypes...>());
+            nearest<0, Metric>(queries[i], 0, best, bestDist);
+            result[i] = previous = best;
+        });
+        return result;
+    }
+
+    /**
+     * Save the tree to a file that load can map, the keys and the value must be trivially copyable
+     * Time complexity: O(kn)
+     * @throw std::runtime_error if the file can not be written
+     */
+    void save(const std::string &path) const {
+        std::string signature = KDTreeFile::signature<Value, KeyTypes...>();
+        std::vector<size_t> offsets = fileLayout(treeSize, signature.size());
+        KDTreeFile::Header header{};
+        std::memcpy(header.magic, KDTreeFile::MAGIC, sizeof(header.magic));
+        header.version = KDTreeFile::VERSION;
+        header.byteOrder = KDTreeFile::ENDIAN_MARK;
+        header.keySize = KeySize;
+        header.packed = Packed;
+        header.treeSize = treeSize;
+        header.signatureSize = signature.size();
+        header.fileSize = offsets.back();
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("can not open " + path);
+        auto writeAt = [&out](size_t offset, const void *data, size_t bytes) {
+            while ((size_t) out.tellp() < offset) out.put('\0');
+            out.write(static_cast<const char *>(data), (std::streamsize) bytes);
+        };
+        writeAt(0, &header, sizeof(header));
+        writeAt(sizeof(header), signature.data(), signature.size());
+        if constexpr (Packed) {
+            writeAt(offsets[0], keyData, treeSize * sizeof(PackedKey));
+        } else {
+            size_t dim = 0;
+            std::apply([&](const auto *...dims) {
+                (writeAt(offsets[dim++], dims, treeSize * sizeof(*dims)), ...);
+            }, keyData);
+        }
+        writeAt(offsets[offsets.size() - 2], valueData, treeSize * sizeof(Value));
+        writeAt(offsets.back(), nullptr, 0);
+        if (!out) throw std::runtime_error("can not write " + path);
+    }
+
+    /**
+     * Map a file written by save, the tree is queried in place without deserialization
+     * Time complexity: O(1), pages are read on demand
+     * @throw std::runtime_error if the file can not be mapped, or is not a tree of the same version and types
+     */
+    static StaticKDTree load(const std::string &path) {
+        StaticKDTree tree;
+        size_t fileSize = 0;
+        tree.mapping = KDTreeFile::map(path, fileSize);
+        const char *base = tree.mapping.get();
+        KDTreeFile::Header header{};
+        if (fileSize < sizeof(header)) throw std::runtime_error(path + " is not a kd-tree file");
+        std::memcpy(&header, base, sizeof(header));
+        if (std::memcmp(header.magic, KDTreeFile::MAGIC, sizeof(header.magic)) != 0) {
+            throw std::runtime_error(path + " is not a kd-tree file");
+        }
+        if (header.version != KDTreeFile::VERSION) {
+            throw std::runtime_error(path + " has unsupported version " + std::to_string(header.version));
+        }
+        if (header.byteOrder != KDTreeFile::ENDIAN_MARK) {
+            throw std::runtime_error(path + " was written on a machine of different byte order");
+        }
+        std::string signature = KDTreeFile::signature<Value, KeyTypes...>();
+        if (header.keySize != KeySize || header.packed != Packed || header.signatureSize != signature.size() ||
+            fileSize < sizeof(header) + signature.size() ||
+            std::memcmp(base + sizeof(header), signature.data(), signature.size()) != 0) {
+            throw std::runtime_error(path + " holds a tree of other key or value types");
+        }
+        std::vector<size_t> offsets = fileLayout(header.treeSize, signature.size());
+        if (header.fileSize != offsets.back() || fileSize < offsets.back()) {
+            throw std::runtime_error(path + " is truncated");
+        }
+        tree.bindFile(offsets, std::index_sequence_for<KeyTypes...>());
+        tree.treeSize = header.treeSize;
+        return tree;
+    }
+
+    /**
+     * @return whether the tree is mapped from a file
+     */
+    bool isMapped() const { return (bool) mapping; }
+
+    size_t size() const { return treeSize; }
+
+    bool empty() const { return treeSize == 0; }
+};
+
+#endif //VE281P3_STATIC_KDTREE_HPP
@@ -0,0 +1,101 @@
+#ifndef VE281P4_BELLMAN_FORD_HPP
+#define VE281P4_BELLMAN_FORD_HPP
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <vector>
+
+#include "csrGraph.hpp"
+
+/**
+ * Negative cycle detection in O(VE) on a sparse graph, by SPFA: Bellman–Ford that only relaxes the out-edges
+ * of vertices whose distance changed, in FIFO order
+ * The search starts from a virtual source with an edge of weight 0 to every vertex, so every cycle is reachable
+ * and the distances are the potentials of Johnson's reweighting
+ * The time complexity of functions are based on V and E
+ */
+namespace BellmanFord {
+    static constexpr unsigned NO_PARENT = UINT_MAX;
+
+    /**
+     * A cycle of the parent graph, the graph of the edges that last improved each vertex
+     * Time Complexity: O(V)
+     * @return v0, v1, ..., with edges v0 -> v1 -> ... -> v0, or nothing if the parent graph is a forest
+     */
+    inline std::vector<unsigned> parentCycle(const std::vector<unsigned> &parent) {
+        size_t V = parent.size();
+        std::vector<unsigned> walk(V, NO_PARENT);   // the first vertex of the walk that reached each vertex
+        for (size_t start = 0; start < V; start++) {
+            unsigned v = (unsigned) start;
+            while (v != NO_PARENT && walk[v] == NO_PARENT) {
+                walk[v] = (unsigned) start;
+                v = parent[v];
+            }
+            if (v == NO_PARENT || walk[v] != start) continue;
+            // v is on a cycle, collected against the edges and then reversed
+            std::vector<unsigned> cycle;
+            unsigned u = v;
+            do {
+                cycle.push_back(u);
+                u = parent[u];
+            } while (u != v);
+            std::reverse(cycle.begin(), cycle.end());
+            return cycle;
+        }
+        return {};
+    }
+
+    /**
+     * Shortest distances from the virtual source
+     * Every cycle of the parent graph is negative, and with a negative cycle the parent graph always has one
+     * after finitely many relaxations, so it is checked once per V relaxations, O(1) per relaxation amortized;
+     * this finds the cycle itself, not only that there is one, and usually long before V passes
+     * Time Complexity: O(VE) worst case, O(V + E) when no weight is negative
+     * @param graph
+     * @param potential the distances on output, meaningless if there is a negative cycle
+     * @param cycle a negative cycle on output as in parentCycle, or nothing
+     * @return false if the graph has a negative cycle
+     */
+    template<typename W>
+    bool potentials(const CSRGraph<W> &graph, std::vector<long long> &potential, std::vector<unsigned> &cycle) {
+        size_t V = graph.vertexCount();
+        potential.assign(V, 0);
+        cycle.clear();
+        bool negative = false;
+        for (size_t e = 0; e < graph.edgeCount() && !negative; e++) negative = graph.weight(e) < 0;
+        if (!negative) return true;
+
+        std::vector<unsigned> queue(V), parent(V, NO_PARENT);
+        std::vector<char> queued(V, 1);
+        for (size_t v = 0; v < V; v++) queue[v] = (unsigned) v;
+        size_t head = 0, length = V;    // queue is a ring buffer of capacity V
+        size_t relaxations = 0;
+        while (length > 0) {
+            unsigned u = queue[head];
+            head = head + 1 == V ? 0 : head + 1;
+            length--;
+            queued[u] = 0;
+            for (size_t e = graph.begin(u); e < graph.end(u); e++) {
+                unsigned v = graph.target(e);
+                long long candidate = potential[u] + graph.weight(e);
+                if (candidate >= potential[v]) continue;
+                potential[v] = candidate;
+                parent[v] = u;
+                if (++relaxations % V == 0) {
+                    cycle = parentCycle(parent);
+                    if (!cycle.empty()) return false;
+                }
+                if (!queued[v]) {
+                    queued[v] = 1;
+                    size_t tail = head + length;
+                    queue[tail >= V ? tail - V : tail] = v;
+                    length++;
+                }
+            }
+        }
+        return true;
+    }
+}
+
+#endif //VE281P4_BELLMAN_FORD_HPP
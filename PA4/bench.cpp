@@ -0,0 +1,467 @@
+#include "contractionHierarchy.hpp"
+#include "floydWarshall.hpp"
+#include "landmarkP2P.hpp"
+#include "sparseP2P.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Benchmark suite of the engines behind ShortestP2P on generated graphs: G(n, m), road-like grids,
+// power-law graphs and DAGs with negative weights
+// - the single-source engines on large sparse graphs: plain Dijkstra (SparseP2P), bidirectional ALT (LandmarkP2P)
+//   and contraction hierarchies
+// - the all-pairs matrix by Floyd–Warshall on graphs of 2000 vertices, next to the same engines
+// - edge updates on the all-pairs matrix against recomputing it
+// Every engine reports its build time, memory and query latency percentiles, Floyd–Warshall also its min-plus
+// throughput: V^3 relaxations of one addition and one minimum, counted as 2 V^3 floating point operations
+// Every answer is checked: Dijkstra against Floyd–Warshall on the small graphs and against Bellman–Ford on the first
+// queries of the large ones, the other engines against Dijkstra, and the updated matrices against running
+// Floyd–Warshall again; the bench exits with 1 if any answer is wrong
+// Usage: ./bench [number of queries] [--json path]
+// --json also writes the results to path, to compare them between releases
+// Build with -O3
+
+template<typename Func>
+double timeMs(Func &&func) {
+    auto start = chrono::steady_clock::now();
+    func();
+    auto end = chrono::steady_clock::now();
+    return (double) chrono::duration_cast<chrono::nanoseconds>(end - start).count() / 1e6;
+}
+
+// one engine on one graph
+struct Result {
+    string graph;
+    string engine;
+    size_t V = 0, E = 0;
+    double buildMs = 0;
+    size_t memoryBytes = 0;
+    vector<double> latencyUs;   // one sample per query, including about 20 ns for reading the clock
+    double gflops = 0;          // min-plus throughput of Floyd–Warshall, 0 for the other engines
+    size_t wrong = 0;           // answers that differ from the reference
+    string note;
+};
+
+// a road-like side x side grid with edges in both directions and independent random weights
+vector<Edge> gridGraph(unsigned side, mt19937 &rng) {
+    uniform_int_distribution<int> weight(1, 100);
+    vector<Edge> edges;
+    for (unsigned r = 0; r < side; r++) {
+        for (unsigned c = 0; c < side; c++) {
+            unsigned u = r * side + c;
+            if (c + 1 < side) {
+                edges.push_back({u, u + 1, weight(rng)});
+                edges.push_back({u + 1, u, weight(rng)});
+            }
+            if (r + 1 < side) {
+                edges.push_back({u, u + side, weight(rng)});
+                edges.push_back({u + side, u, weight(rng)});
+            }
+        }
+    }
+    return edges;
+}
+
+// G(n, m) with non-negative weights shifted by a random potential, so some weights are negative but no cycle is
+vector<Edge> randomGraph(unsigned n, size_t m, mt19937 &rng) {
+    uniform_int_distribution<unsigned> vertex(0, n - 1);
+    uniform_int_distribution<int> weight(0, 100), shift(0, 50);
+    vector<int> h(n);
+    for (auto &x : h) x = shift(rng);
+    vector<Edge> edges(m);
+    for (auto &edge : edges) {
+        edge.from = vertex(rng);
+        edge.to = vertex(rng);
+        edge.weight = weight(rng) + h[edge.from] - h[edge.to];
+    }
+    return edges;
+}
+
+// Chung–Lu graph with degrees following a power law of exponent 2.5: both ends of every edge are drawn
+// with probability proportional to (i + 1)^(-1 / 1.5), so a few hubs have most of the edges;
+// weights are shifted by a random potential as in randomGraph
+vector<Edge> powerLawGraph(unsigned n, size_t m, mt19937 &rng) {
+    vector<double> degree(n);
+    for (unsigned i = 0; i < n; i++) degree[i] = pow(i + 1.0, -1 / 1.5);
+    discrete_distribution<unsigned> vertex(degree.begin(), degree.end());
+    uniform_int_distribution<int> weight(0, 100), shift(0, 50);
+    vector<int> h(n);
+    for (auto &x : h) x = shift(rng);
+    vector<Edge> edges(m);
+    for (auto &edge : edges) {
+        edge.from = vertex(rng);
+        edge.to = vertex(rng);
+        edge.weight = weight(rng) + h[edge.from] - h[edge.to];
+    }
+    return edges;
+}
+
+// a DAG over a random order of the vertices with weights in [-100, 100]: many negative weights and no cycle,
+// so the potentials of Johnson's reweighting take more than one pass
+vector<Edge> negativeDag(unsigned n, size_t m, mt19937 &rng) {
+    vector<unsigned> order(n);
+    iota(order.begin(), order.end(), 0);
+    shuffle(order.begin(), order.end(), rng);
+    uniform_int_distribution<unsigned> position(0, n - 1);
+    uniform_int_distribution<int> weight(-100, 100);
+    vector<Edge> edges(m);
+    for (auto &edge : edges) {
+        unsigned a = position(rng), b = position(rng);
+        while (a == b) b = position(rng);
+        if (a > b) swap(a, b);
+        edge = {order[a], order[b], weight(rng)};
+    }
+    return edges;
+}
+
+double percentile(vector<double> samples, double p) {
+    if (samples.empty()) return 0;
+    sort(samples.begin(), samples.end());
+    return samples[min(samples.size() - 1, (size_t) (p * (double) samples.size()))];
+}
+
+double mean(const vector<double> &samples) {
+    double sum = 0;
+    for (double sample : samples) sum += sample;
+    return samples.empty() ? 0 : sum / (double) samples.size();
+}
+
+void printHeader() {
+    printf("%-8s %-20s %8s %8s %10s %9s %9s %9s %9s %8s\n", "graph", "engine", "V", "E", "build ms", "MB",
+           "p50 us", "p99 us", "mean us", "GFLOP/s");
+}
+
+void print(const Result &result) {
+    printf("%-8s %-20s %8zu %8zu %10.1f %9.1f", result.graph.c_str(), result.engine.c_str(), result.V, result.E,
+           result.buildMs, (double) result.memoryBytes / (1 << 20));
+    if (result.latencyUs.empty()) printf(" %9s %9s %9s", "-", "-", "-");
+    else printf(" %9.2f %9.2f %9.2f", percentile(result.latencyUs, 0.5), percentile(result.latencyUs, 0.99),
+                mean(result.latencyUs));
+    if (result.gflops > 0) printf(" %8.2f", result.gflops);
+    else printf(" %8s", "-");
+    if (result.wrong) printf("  %zu wrong answers", result.wrong);
+    if (!result.note.empty()) printf("  %s", result.note.c_str());
+    printf("\n");
+    fflush(stdout);
+}
+
+// the same random pairs for every engine on a graph
+vector<pair<unsigned, unsigned>> queryPairs(unsigned V, size_t queries) {
+    mt19937 rng(281);
+    uniform_int_distribution<unsigned> vertex(0, V - 1);
+    vector<pair<unsigned, unsigned>> pairs(queries);
+    for (auto &query : pairs) query = {vertex(rng), vertex(rng)};
+    return pairs;
+}
+
+// time each query, and count the answers that differ from expected, which may only cover the first queries
+template<typename Query>
+void measureQueries(Result &result, const vector<pair<unsigned, unsigned>> &pairs, const vector<long long> &expected,
+                    Query query) {
+    for (size_t q = 0; q < pairs.size(); q++) {
+        long long d = 0;
+        result.latencyUs.push_back(1000 * timeMs([&] { d = query(pairs[q].first, pairs[q].second); }));
+        if (q < expected.size()) result.wrong += d != expected[q];
+    }
+}
+
+// the distances of pairs computed without the engines: by Floyd–Warshall in 64 bits on small graphs,
+// otherwise by Bellman–Ford with a FIFO queue from each of the first sampled sources
+vector<long long> referenceDistances(unsigned V, const vector<Edge> &edges, const vector<pair<unsigned, unsigned>> &pairs,
+                                     size_t sampled) {
+    vector<long long> reference;
+    if (V <= 4096) {
+        DistanceMatrix<long long> dist(V, FloydWarshall::TILE);
+        for (auto &edge : edges) {
+            if (edge.from != edge.to || edge.weight < 0) dist(edge.from, edge.to) = edge.weight;
+        }
+        FloydWarshall::run(dist);
+        for (auto &query : pairs) {
+            long long d = dist(query.first, query.second);
+            reference.push_back(d == DistanceMatrix<long long>::INF ? SparseP2P::UNREACHABLE : d);
+        }
+        return reference;
+    }
+    // the last of parallel edges wins, as in the matrix
+    unordered_map<uint64_t, int> last;
+    for (auto &edge : edges) last[(uint64_t) edge.from << 32 | edge.to] = edge.weight;
+    vector<vector<pair<unsigned, int>>> out(V);
+    for (auto &edge : last) out[edge.first >> 32].emplace_back((unsigned) edge.first, edge.second);
+    vector<long long> dist(V);
+    vector<char> queued(V);
+    deque<unsigned> queue;
+    for (size_t q = 0; q < min(sampled, pairs.size()); q++) {
+        fill(dist.begin(), dist.end(), SparseP2P::UNREACHABLE);
+        dist[pairs[q].first] = 0;
+        queue.push_back(pairs[q].first);
+        while (!queue.empty()) {
+            unsigned u = queue.front();
+            queue.pop_front();
+            queued[u] = 0;
+            for (auto &arc : out[u]) {
+                if (dist[u] + arc.second >= dist[arc.first]) continue;
+                dist[arc.first] = dist[u] + arc.second;
+                if (!queued[arc.first]) {
+                    queued[arc.first] = 1;
+                    queue.push_back(arc.first);
+                }
+            }
+        }
+        reference.push_back(dist[pairs[q].second]);
+    }
+    return reference;
+}
+
+// the single-source engines; hierarchy is false for graphs without a hierarchy to exploit, such as G(n, m),
+// where contraction creates a quadratic number of shortcuts
+void sparseEngines(const string &name, unsigned V, const vector<Edge> &edges, size_t queries, bool hierarchy,
+                   vector<Result> &results) {
+    const unsigned landmarkCount = 16;
+    auto pairs = queryPairs(V, queries);
+    auto result = [&](const string &engine) {
+        Result r;
+        r.graph = name;
+        r.engine = engine;
+        r.V = V;
+        r.E = edges.size();
+        return r;
+    };
+
+    Result dijkstra = result("dijkstra");
+    SparseP2P sparse;
+    dijkstra.buildMs = timeMs([&] { sparse.build(V, edges); });
+    dijkstra.memoryBytes = sparse.memoryBytes();
+    vector<long long> reference = referenceDistances(V, edges, pairs, 20);
+    measureQueries(dijkstra, pairs, reference, [&](unsigned A, unsigned B) { return sparse.distance(A, B); });
+    // Dijkstra answers all queries, the reference may only answer the first ones
+    vector<long long> expected;
+    for (auto &query : pairs) expected.push_back(sparse.distance(query.first, query.second));
+    results.push_back(dijkstra);
+    print(results.back());
+
+    Result alt = result("alt " + to_string(landmarkCount) + " landmarks");
+    LandmarkP2P landmarks;
+    alt.buildMs = dijkstra.buildMs + timeMs([&] { landmarks.build(sparse, landmarkCount); });
+    alt.memoryBytes = sparse.memoryBytes() + landmarks.memoryBytes();
+    measureQueries(alt, pairs, expected, [&](unsigned A, unsigned B) { return landmarks.distance(A, B); });
+    results.push_back(alt);
+    print(results.back());
+
+    if (!hierarchy) return;
+    Result ch = result("contraction");
+    ContractionHierarchy contracted;
+    ch.buildMs = dijkstra.buildMs + timeMs([&] { contracted.build(sparse); });
+    ch.memoryBytes = contracted.memoryBytes();
+    string indexPath = "bench_" + name + ".ch";
+    double saveMs = timeMs([&] { contracted.save(indexPath); });
+    double loadMs = timeMs([&] { contracted.load(indexPath, sparse); });
+    remove(indexPath.c_str());
+    char note[128];
+    snprintf(note, sizeof(note), "%zu edges with shortcuts, index saved in %.0f ms, loaded in %.0f ms",
+             contracted.edgeCount(), saveMs, loadMs);
+    ch.note = note;
+    measureQueries(ch, pairs, expected, [&](unsigned A, unsigned B) { return contracted.distance(A, B); });
+    results.push_back(ch);
+    print(results.back());
+}
+
+// the all-pairs matrix of 32-bit distances on the given threads, then one lookup per query
+void allPairs(const string &name, unsigned V, const vector<Edge> &edges, size_t queries, size_t threads,
+              vector<Result> &results) {
+    auto pairs = queryPairs(V, queries);
+    SparseP2P sparse;
+    sparse.build(V, edges);
+    vector<long long> expected;
+    for (auto &query : pairs) expected.push_back(sparse.distance(query.first, query.second));
+
+    Result result;
+    result.graph = name;
+    result.engine = "floyd-warshall x" + to_string(threads);
+    result.V = V;
+    result.E = edges.size();
+    DistanceMatrix<int> dist(V, FloydWarshall::TILE);
+    result.buildMs = timeMs([&] {
+        // a non-negative self-loop never beats the empty path
+        for (auto &edge : edges) {
+            if (edge.from != edge.to || edge.weight < 0) dist(edge.from, edge.to) = edge.weight;
+        }
+        FloydWarshall::run(dist, threads);
+    });
+    result.memoryBytes = DistanceMatrix<int>::bytes(V, FloydWarshall::TILE);
+    result.gflops = 2 * pow((double) V, 3) / (result.buildMs * 1e6);
+    measureQueries(result, pairs, expected, [&](unsigned A, unsigned B) {
+        int d = dist(A, B);
+        return d == DistanceMatrix<int>::INF ? SparseP2P::UNREACHABLE : (long long) d;
+    });
+    results.push_back(result);
+    print(results.back());
+}
+
+// single edge updates on the all-pairs matrix of G(n, m), against running Floyd–Warshall again
+void updates(unsigned V, size_t updates, vector<Result> &results) {
+    mt19937 rng(281);
+    vector<Edge> edges = randomGraph(V, (size_t) V * 8, rng);
+    unordered_map<uint64_t, int> weights;
+    DistanceMatrix<int> dist(V, FloydWarshall::TILE);
+    for (auto &edge : edges) {
+        if (edge.from == edge.to) continue;
+        dist(edge.from, edge.to) = edge.weight;
+        weights[(uint64_t) edge.from << 32 | edge.to] = edge.weight;
+    }
+    double fullMs = timeMs([&] { FloydWarshall::run(dist); });
+    auto direct = [&](unsigned from, unsigned to) {
+        if (from == to) return 0;
+        auto edge = weights.find((uint64_t) from << 32 | to);
+        return edge == weights.end() ? DistanceMatrix<int>::INF : edge->second;
+    };
+    // the entries of the repaired matrix that differ from running Floyd–Warshall again on the current weights
+    auto wrongEntries = [&] {
+        DistanceMatrix<int> fresh(V, FloydWarshall::TILE);
+        for (auto &weight : weights) fresh((unsigned) (weight.first >> 32), (unsigned) weight.first) = weight.second;
+        FloydWarshall::run(fresh);
+        size_t wrong = 0;
+        for (unsigned i = 0; i < V; i++) {
+            for (unsigned j = 0; j < V; j++) wrong += dist(i, j) != fresh(i, j);
+        }
+        return wrong;
+    };
+
+    Result decrease, increase;
+    for (Result *result : {&decrease, &increase}) {
+        result->graph = "random";
+        result->V = V;
+        result->E = edges.size();
+        result->buildMs = fullMs;
+        result->memoryBytes = DistanceMatrix<int>::bytes(V, FloydWarshall::TILE);
+    }
+    decrease.engine = "update decrease";
+    increase.engine = "update increase";
+    size_t pairs = 0, recomputed = 0;
+    vector<pair<unsigned, unsigned>> affected;
+    DistanceMatrix<uint16_t> *noHops = nullptr;
+    uniform_int_distribution<size_t> pick(0, edges.size() - 1);
+    for (size_t q = 0; q < updates; q++) {
+        Edge edge = edges[pick(rng)];
+        if (edge.from == edge.to) continue;
+        uint64_t key = (uint64_t) edge.from << 32 | edge.to;
+        int before = weights[key];
+        // an increase that keeps the edge on some shortest paths, then the decrease back to the old weight
+        increase.latencyUs.push_back(1000 * timeMs([&] {
+            weights[key] = before + 50;
+            if (FloydWarshall::affectedPairs(dist, edge.from, edge.to, before, (size_t) V * V / 32, affected)) {
+                FloydWarshall::recomputePairs(dist, noHops, affected, direct);
+            } else {
+                recomputed++;
+                dist = DistanceMatrix<int>(V, FloydWarshall::TILE);
+                for (auto &weight : weights) dist((unsigned) (weight.first >> 32), (unsigned) weight.first) = weight.second;
+                FloydWarshall::run(dist);
+            }
+        }));
+        pairs += affected.size();
+        if (increase.latencyUs.size() == 1) increase.wrong = wrongEntries();
+        decrease.latencyUs.push_back(1000 * timeMs([&] {
+            weights[key] = before;
+            FloydWarshall::decreaseEdge(dist, noHops, edge.from, edge.to, before);
+        }));
+    }
+    decrease.wrong = wrongEntries();
+    char note[128];
+    snprintf(note, sizeof(note), "%.0f affected pairs on average, %zu over the limit",
+             (double) pairs / (double) max<size_t>(1, increase.latencyUs.size()), recomputed);
+    increase.note = note;
+    results.push_back(decrease);
+    print(results.back());
+    results.push_back(increase);
+    print(results.back());
+}
+
+// the engine and graph names are plain ASCII, quotes and backslashes are the only characters to escape
+string jsonString(const string &text) {
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+bool writeJson(const string &path, size_t queries, const vector<Result> &results) {
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) return false;
+    fprintf(file, "{\n  \"queries\": %zu,\n  \"hardwareThreads\": %u,\n  \"results\": [", queries,
+            thread::hardware_concurrency());
+    for (size_t r = 0; r < results.size(); r++) {
+        const Result &result = results[r];
+        fprintf(file, "%s\n    {\"graph\": %s, \"engine\": %s, \"V\": %zu, \"E\": %zu, \"buildMs\": %.3f, "
+                      "\"memoryBytes\": %zu, \"queries\": %zu, \"p50Us\": %.3f, \"p90Us\": %.3f, \"p99Us\": %.3f, "
+                      "\"meanUs\": %.3f, \"gflops\": %.3f, \"wrong\": %zu, \"note\": %s}",
+                r ? "," : "", jsonString(result.graph).c_str(), jsonString(result.engine).c_str(), result.V,
+                result.E, result.buildMs, result.memoryBytes, result.latencyUs.size(),
+                percentile(result.latencyUs, 0.5), percentile(result.latencyUs, 0.9),
+                percentile(result.latencyUs, 0.99), mean(result.latencyUs), result.gflops, result.wrong,
+                jsonString(result.note).c_str());
+    }
+    fprintf(file, "\n  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+int main(int argc, char **argv) {
+    size_t queries = 200;
+    string jsonPath;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--json" && i + 1 < argc) jsonPath = argv[++i];
+        else queries = stoul(arg);
+    }
+    vector<Result> results;
+    mt19937 rng(281);
+    printHeader();
+
+    unsigned side = 250;
+    sparseEngines("grid", side * side, gridGraph(side, rng), queries, true, results);
+    sparseEngines("random", 200000, randomGraph(200000, 800000, rng), queries, false, results);
+    sparseEngines("powerlaw", 200000, powerLawGraph(200000, 800000, rng), queries, false, results);
+    sparseEngines("dag", 200000, negativeDag(200000, 800000, rng), queries, false, results);
+
+    // small enough for the all-pairs matrix, which answers 100 times more queries
+    size_t threads = max(1u, thread::hardware_concurrency());
+    struct Graph {
+        string name;
+        unsigned V;
+        vector<Edge> edges;
+    };
+    vector<Graph> graphs = {{"grid", 45 * 45, gridGraph(45, rng)},
+                            {"random", 2048, randomGraph(2048, 2048 * 8, rng)},
+                            {"powerlaw", 2048, powerLawGraph(2048, 2048 * 8, rng)},
+                            {"dag", 2048, negativeDag(2048, 2048 * 8, rng)}};
+    for (auto &graph : graphs) {
+        sparseEngines(graph.name, graph.V, graph.edges, queries, graph.name == "grid", results);
+        allPairs(graph.name, graph.V, graph.edges, queries * 100, 1, results);
+        if (threads > 1) allPairs(graph.name, graph.V, graph.edges, queries * 100, threads, results);
+    }
+
+    updates(2048, queries, results);
+
+    if (!jsonPath.empty() && !writeJson(jsonPath, queries, results)) {
+        fprintf(stderr, "can not write %s\n", jsonPath.c_str());
+        return 1;
+    }
+    size_t wrong = 0;
+    for (auto &result : results) wrong += result.wrong;
+    if (wrong) {
+        printf("%zu wrong answers\n", wrong);
+        return 1;
+    }
+    return 0;
+}
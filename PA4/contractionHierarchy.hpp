@@ -0,0 +1,482 @@
+#ifndef VE281P4_CONTRACTION_HIERARCHY_HPP
+#define VE281P4_CONTRACTION_HIERARCHY_HPP
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "csrGraph.hpp"
+#include "radixHeap.hpp"
+#include "sparseP2P.hpp"
+
+/**
+ * Point-to-point queries by contraction hierarchies, on the Johnson-reduced weights of a SparseP2P
+ * Preprocessing contracts the vertices one by one in order of edge difference (twice shortcuts added minus edges
+ * removed, plus the number of contracted neighbors to spread the contraction evenly), updated lazily;
+ * contracting v adds a shortcut u -> w for each pair of edges u -> v -> w unless a bounded witness search
+ * finds a path from u to w avoiding v that is no longer
+ * A query is a bidirectional Dijkstra search that only follows edges towards vertices contracted later,
+ * with stall on demand, which on road-like graphs settles a few hundred vertices regardless of the graph size
+ * The index can be saved to a file and loaded back for the same graph
+ * The time complexity of functions are based on V, E and the number of shortcuts S
+ */
+class ContractionHierarchy {
+public:
+    static constexpr long long UNREACHABLE = SparseP2P::UNREACHABLE;
+    static constexpr size_t WITNESS_SETTLE_LIMIT = 200;        // vertices settled by one witness search
+    static constexpr size_t SIMULATION_SETTLE_LIMIT = 20;      // the same when only estimating the priority
+
+private:
+    static constexpr uint64_t UNREACHED = UINT64_MAX;
+    static constexpr char MAGIC[8] = {'V', 'E', '2', '8', '1', 'C', 'H', 'I'};
+    static constexpr uint32_t VERSION = 1;
+
+    struct Arc {
+        unsigned to;
+        uint64_t weight;
+    };
+
+    /**
+     * Edges towards vertices of higher rank, in CSR form
+     */
+    struct UpwardGraph {
+        std::vector<uint64_t> offsets;
+        std::vector<unsigned> targets;
+        std::vector<uint64_t> weights;
+
+        size_t edgeCount() const { return targets.size(); }
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t vertexCount;
+        uint64_t upEdges;
+        uint64_t downEdges;
+        uint64_t graphHash;
+    };
+
+    struct Search {
+        std::vector<uint64_t> dist;
+        RadixHeap<unsigned> heap;
+    };
+
+    UpwardGraph up;         // u -> w with rank(w) > rank(u)
+    UpwardGraph down;       // at w: u -> w with rank(u) > rank(w), searched backward from the target
+    std::vector<long long> potential;
+    uint64_t graphHash = 0;
+
+    Search forward, backward;
+    std::vector<unsigned> touched;
+
+    /**
+     * The dynamic graph during contraction, with a bounded Dijkstra search for witnesses
+     */
+    class Contractor {
+        std::vector<std::vector<Arc>> out, in;
+        std::vector<char> contracted;
+        std::vector<uint64_t> witnessDist;
+        std::vector<unsigned> witnessTouched;
+        std::vector<unsigned> isTarget;     // isTarget[w] = v while w is an out-neighbor of v being contracted
+        typedef std::pair<uint64_t, unsigned> HeapItem;
+        std::vector<HeapItem> heap;
+
+        /**
+         * Bounded Dijkstra from source avoiding via
+         * Stops when the distance exceeds limit, when all out-neighbors of via are settled,
+         * or after settleLimit vertices; a witness it misses only costs an unnecessary shortcut
+         */
+        void witnessSearch(unsigned source, unsigned via, uint64_t limit, size_t settleLimit) {
+            for (unsigned v : witnessTouched) witnessDist[v] = UNREACHED;
+            witnessTouched.clear();
+            heap.clear();
+            // only the out-neighbors the search can settle: the source is not a target, and contracted vertices are
+            // never entered
+            size_t targets = 0;
+            for (const Arc &arc : out[via]) targets += arc.to != source && !contracted[arc.to];
+            witnessDist[source] = 0;
+            witnessTouched.push_back(source);
+            heap.emplace_back(0, source);
+            for (size_t settled = 0; !heap.empty() && settled < settleLimit && targets > 0; settled++) {
+                std::pop_heap(heap.begin(), heap.end(), std::greater<HeapItem>());
+                HeapItem item = heap.back();
+                heap.pop_back();
+                if (item.first != witnessDist[item.second]) continue;
+                if (item.first > limit) break;
+                if (isTarget[item.second] == via && item.second != source) targets--;
+                for (const Arc &arc : out[item.second]) {
+                    if (arc.to == via || contracted[arc.to]) continue;
+                    uint64_t candidate = item.first + arc.weight;
+                    if (candidate >= witnessDist[arc.to]) continue;
+                    if (witnessDist[arc.to] == UNREACHED) witnessTouched.push_back(arc.to);
+                    witnessDist[arc.to] = candidate;
+                    heap.emplace_back(candidate, arc.to);
+                    std::push_heap(heap.begin(), heap.end(), std::greater<HeapItem>());
+                }
+            }
+        }
+
+        static void addOrImprove(std::vector<Arc> &arcs, unsigned to, uint64_t weight) {
+            for (Arc &arc : arcs) {
+                if (arc.to == to) {
+                    arc.weight = std::min(arc.weight, weight);
+                    return;
+                }
+            }
+            arcs.push_back({to, weight});
+        }
+
+        static void removeArc(std::vector<Arc> &arcs, unsigned to) {
+            for (size_t i = 0; i < arcs.size(); i++) {
+                if (arcs[i].to == to) {
+                    arcs[i] = arcs.back();
+                    arcs.pop_back();
+                    return;
+                }
+            }
+        }
+
+    public:
+        std::vector<unsigned> contractedNeighbors;
+
+        Contractor(const CSRGraph<int> &graph, const std::vector<long long> &potential)
+                : out(graph.vertexCount()), in(graph.vertexCount()), contracted(graph.vertexCount(), 0),
+                  witnessDist(graph.vertexCount(), UNREACHED), isTarget(graph.vertexCount(), UINT_MAX),
+                  contractedNeighbors(graph.vertexCount(), 0) {
+            for (size_t u = 0; u < graph.vertexCount(); u++) {
+                for (size_t e = graph.begin(u); e < graph.end(u); e++) {
+                    unsigned v = graph.target(e);
+                    if (v == u) continue;
+                    uint64_t weight = (uint64_t) (graph.weight(e) + potential[u] - potential[v]);
+                    out[u].push_back({v, weight});
+                    in[v].push_back({(unsigned) u, weight});
+                }
+            }
+        }
+
+        /**
+         * Visit the shortcuts needed to contract v as (from, to, weight)
+         * Time Complexity: O(in-degree * witness search)
+         */
+        template<typename Visitor>
+        void forEachShortcut(unsigned v, size_t settleLimit, Visitor visit) {
+            uint64_t maxOut = 0;
+            for (const Arc &arc : out[v]) {
+                maxOut = std::max(maxOut, arc.weight);
+                isTarget[arc.to] = v;
+            }
+            for (const Arc &from : in[v]) {
+                witnessSearch(from.to, v, from.weight + maxOut, settleLimit);
+                for (const Arc &to : out[v]) {
+                    if (to.to == from.to) continue;
+                    uint64_t through = from.weight + to.weight;
+                    if (witnessDist[to.to] > through) visit(from.to, to.to, through);
+                }
+            }
+        }
+
+        /**
+         * Priority of contracting v next, smaller first
+         */
+        long long priority(unsigned v) {
+            long long shortcuts = 0;
+            forEachShortcut(v, SIMULATION_SETTLE_LIMIT, [&](unsigned, unsigned, uint64_t) { shortcuts++; });
+            return 2 * (shortcuts - (long long) (in[v].size() + out[v].size())) + contractedNeighbors[v];
+        }
+
+        /**
+         * Contract v: add its shortcuts, hand its remaining edges to the hierarchy and detach it
+         * @return the remaining edges of v as (upward out-edges, upward in-edges)
+         */
+        std::pair<std::vector<Arc>, std::vector<Arc>> contract(unsigned v) {
+            std::vector<std::pair<unsigned, Arc>> shortcuts;
+            forEachShortcut(v, WITNESS_SETTLE_LIMIT, [&](unsigned from, unsigned to, uint64_t weight) {
+                shortcuts.push_back({from, {to, weight}});
+            });
+            for (auto &shortcut : shortcuts) {
+                addOrImprove(out[shortcut.first], shortcut.second.to, shortcut.second.weight);
+                addOrImprove(in[shortcut.second.to], shortcut.first, shortcut.second.weight);
+            }
+            contracted[v] = 1;
+            for (const Arc &arc : out[v]) {
+                removeArc(in[arc.to], v);
+                contractedNeighbors[arc.to]++;
+            }
+            for (const Arc &arc : in[v]) {
+                removeArc(out[arc.to], v);
+                contractedNeighbors[arc.to]++;
+            }
+            std::pair<std::vector<Arc>, std::vector<Arc>> remaining(std::move(out[v]), std::move(in[v]));
+            out[v].clear();
+            in[v].clear();
+            return remaining;
+        }
+    };
+
+    static UpwardGraph toCSR(std::vector<std::vector<Arc>> &arcs) {
+        UpwardGraph graph;
+        graph.offsets.assign(arcs.size() + 1, 0);
+        for (size_t v = 0; v < arcs.size(); v++) graph.offsets[v + 1] = graph.offsets[v] + arcs[v].size();
+        graph.targets.reserve(graph.offsets.back());
+        graph.weights.reserve(graph.offsets.back());
+        for (auto &list : arcs) {
+            for (const Arc &arc : list) {
+                graph.targets.push_back(arc.to);
+                graph.weights.push_back(arc.weight);
+            }
+            std::vector<Arc>().swap(list);
+        }
+        return graph;
+    }
+
+    /**
+     * FNV-1a over the vertex count and the edges, to recognize the graph an index was built for
+     */
+    static uint64_t hashGraph(const CSRGraph<int> &graph) {
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&](uint64_t value) {
+            for (int byte = 0; byte < 8; byte++) {
+                hash ^= (value >> (8 * byte)) & 0xff;
+                hash *= 1099511628211ull;
+            }
+        };
+        mix(graph.vertexCount());
+        for (size_t u = 0; u < graph.vertexCount(); u++) {
+            mix(graph.end(u) - graph.begin(u));
+            for (size_t e = graph.begin(u); e < graph.end(u); e++) {
+                mix(graph.target(e));
+                mix((uint64_t) (int64_t) graph.weight(e));
+            }
+        }
+        return hash;
+    }
+
+    void resetSearch() {
+        size_t V = potential.size();
+        forward.dist.assign(V, UNREACHED);
+        backward.dist.assign(V, UNREACHED);
+        touched.clear();
+    }
+
+    /**
+     * Settle the top vertex of one direction and relax its upward edges
+     */
+    void step(bool reversed, uint64_t &best) {
+        Search &search = reversed ? backward : forward;
+        const Search &other = reversed ? forward : backward;
+        const UpwardGraph &graph = reversed ? down : up;
+        const UpwardGraph &opposite = reversed ? up : down;
+        auto item = search.heap.pop();
+        unsigned u = item.second;
+        if (item.first != search.dist[u]) return;
+        if (other.dist[u] != UNREACHED) best = std::min(best, item.first + other.dist[u]);
+        // stall on demand: if a higher vertex reached by this search already gives a shorter path to u,
+        // u is not on a shortest up-down path and its edges need not be relaxed
+        for (size_t e = opposite.offsets[u]; e < opposite.offsets[u + 1]; e++) {
+            uint64_t higher = search.dist[opposite.targets[e]];
+            if (higher != UNREACHED && higher + opposite.weights[e] < item.first) return;
+        }
+        for (size_t e = graph.offsets[u]; e < graph.offsets[u + 1]; e++) {
+            unsigned v = graph.targets[e];
+            uint64_t candidate = item.first + graph.weights[e];
+            if (candidate >= search.dist[v]) continue;
+            if (forward.dist[v] == UNREACHED && backward.dist[v] == UNREACHED) touched.push_back(v);
+            search.dist[v] = candidate;
+            search.heap.push(candidate, v);
+        }
+    }
+
+    template<typename T>
+    static void writeArray(std::ofstream &file, const std::vector<T> &array) {
+        file.write(reinterpret_cast<const char *>(array.data()), (std::streamsize) (array.size() * sizeof(T)));
+    }
+
+    template<typename T>
+    static void readArray(std::ifstream &file, std::vector<T> &array, size_t size) {
+        array.resize(size);
+        file.read(reinterpret_cast<char *>(array.data()), (std::streamsize) (size * sizeof(T)));
+    }
+
+public:
+    /**
+     * Contract the graph of a SparseP2P
+     * Time Complexity: depends on the graph, about O((V + S) * witness search) on road-like graphs
+     * @param sparse a built SparseP2P without negative cycles
+     */
+    void build(const SparseP2P &sparse) {
+        const CSRGraph<int> &graph = sparse.getGraph();
+        size_t V = graph.vertexCount();
+        potential = sparse.getPotential();
+        graphHash = hashGraph(graph);
+        Contractor contractor(graph, potential);
+
+        typedef std::pair<long long, unsigned> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+        std::vector<long long> current(V);
+        for (unsigned v = 0; v < V; v++) {
+            current[v] = contractor.priority(v);
+            queue.emplace(current[v], v);
+        }
+        std::vector<char> done(V, 0);
+        std::vector<std::vector<Arc>> upArcs(V), downArcs(V);
+        while (!queue.empty()) {
+            Entry entry = queue.top();
+            queue.pop();
+            unsigned v = entry.second;
+            if (done[v] || entry.first != current[v]) continue;
+            // lazy update: contract v only if it is still minimal with its priority recomputed
+            long long updated = contractor.priority(v);
+            if (updated > current[v] && !queue.empty() && updated > queue.top().first) {
+                current[v] = updated;
+                queue.emplace(updated, v);
+                continue;
+            }
+            done[v] = 1;
+            auto remaining = contractor.contract(v);
+            upArcs[v] = std::move(remaining.first);
+            downArcs[v] = std::move(remaining.second);
+            std::vector<unsigned> neighbors;
+            for (const Arc &arc : upArcs[v]) neighbors.push_back(arc.to);
+            for (const Arc &arc : downArcs[v]) neighbors.push_back(arc.to);
+            std::sort(neighbors.begin(), neighbors.end());
+            neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+            for (unsigned w : neighbors) {
+                if (done[w]) continue;
+                current[w] = contractor.priority(w);
+                queue.emplace(current[w], w);
+            }
+        }
+        up = toCSR(upArcs);
+        down = toCSR(downArcs);
+        resetSearch();
+    }
+
+    /**
+     * Time Complexity: O(size of the search spaces), a few hundred vertices on road-like graphs
+     * @return the shortest distance from A to B, or UNREACHABLE if B can not be reached from A
+     */
+    long long distance(unsigned A, unsigned B) {
+        for (unsigned v : touched) forward.dist[v] = backward.dist[v] = UNREACHED;
+        touched.clear();
+        forward.heap.clear();
+        backward.heap.clear();
+        forward.dist[A] = 0;
+        backward.dist[B] = 0;
+        touched.push_back(A);
+        touched.push_back(B);
+        forward.heap.push(0, A);
+        backward.heap.push(0, B);
+        uint64_t best = UNREACHED;
+        // each direction stops on its own once it can not improve the best path any more
+        while (true) {
+            bool forwardOpen = !forward.heap.empty() && forward.heap.topKey() < best;
+            bool backwardOpen = !backward.heap.empty() && backward.heap.topKey() < best;
+            if (!forwardOpen && !backwardOpen) break;
+            bool reversed = !forwardOpen || (backwardOpen && backward.heap.topKey() < forward.heap.topKey());
+            step(reversed, best);
+        }
+        if (best == UNREACHED) return UNREACHABLE;
+        return (long long) best - potential[A] + potential[B];
+    }
+
+    /**
+     * Write the index in binary form, for a machine of the same endianness
+     * @throw std::runtime_error if the file can not be written
+     */
+    void save(const std::string &path) const {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) throw std::runtime_error("can not open " + path);
+        Header header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.vertexCount = potential.size();
+        header.upEdges = up.edgeCount();
+        header.downEdges = down.edgeCount();
+        header.graphHash = graphHash;
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (const UpwardGraph *graph : {&up, &down}) {
+            writeArray(file, graph->offsets);
+            writeArray(file, graph->targets);
+            writeArray(file, graph->weights);
+        }
+        writeArray(file, potential);
+        if (!file) throw std::runtime_error("can not write " + path);
+    }
+
+    /**
+     * Read an index written by save; the hierarchy is unchanged if this throws
+     * @param path
+     * @param sparse the graph the index must have been built for
+     * @throw std::runtime_error if the file can not be read, was not built for this graph, or is damaged
+     */
+    void load(const std::string &path, const SparseP2P &sparse) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) throw std::runtime_error("can not open " + path);
+        uint64_t fileSize = (uint64_t) file.tellg();
+        file.seekg(0);
+        Header header{};
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if (!file || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+            throw std::runtime_error(path + " is not a contraction hierarchy index");
+        }
+        uint64_t expectedHash = hashGraph(sparse.getGraph());
+        if (header.vertexCount != sparse.vertexCount() || header.graphHash != expectedHash) {
+            throw std::runtime_error(path + " was built for another graph");
+        }
+        size_t V = header.vertexCount;
+        // check the edge counts against the file size before allocating anything for them
+        const uint64_t edgeBytes = sizeof(unsigned) + sizeof(uint64_t);
+        uint64_t fixedBytes = sizeof(Header) + 2 * (V + 1) * sizeof(uint64_t) + V * sizeof(long long);
+        if (fileSize < fixedBytes || header.upEdges > (fileSize - fixedBytes) / edgeBytes ||
+            header.downEdges > (fileSize - fixedBytes) / edgeBytes - header.upEdges ||
+            fixedBytes + (header.upEdges + header.downEdges) * edgeBytes != fileSize) {
+            throw std::runtime_error(path + " is truncated");
+        }
+        UpwardGraph loaded[2];
+        for (UpwardGraph &graph : loaded) {
+            size_t edges = &graph == loaded ? header.upEdges : header.downEdges;
+            readArray(file, graph.offsets, V + 1);
+            readArray(file, graph.targets, edges);
+            readArray(file, graph.weights, edges);
+            if (!file) throw std::runtime_error(path + " is truncated");
+            // step() trusts both, so a damaged index must not get past here
+            bool valid = graph.offsets[0] == 0 && graph.offsets[V] == edges;
+            for (size_t v = 0; valid && v < V; ++v) valid = graph.offsets[v] <= graph.offsets[v + 1];
+            for (size_t e = 0; valid && e < edges; ++e) valid = graph.targets[e] < V;
+            if (!valid) throw std::runtime_error(path + " is damaged");
+        }
+        std::vector<long long> loadedPotential;
+        readArray(file, loadedPotential, V);
+        if (!file) throw std::runtime_error(path + " is truncated");
+        up = std::move(loaded[0]);
+        down = std::move(loaded[1]);
+        potential = std::move(loadedPotential);
+        graphHash = header.graphHash;
+        resetSearch();
+    }
+
+    /**
+     * @return number of edges in the hierarchy, original edges plus shortcuts
+     */
+    size_t edgeCount() const { return up.edgeCount() + down.edgeCount(); }
+
+    /**
+     * @return bytes of the index, as stored in memory and on disk
+     */
+    size_t memoryBytes() const {
+        return sizeof(Header) + (up.offsets.size() + down.offsets.size()) * sizeof(uint64_t) +
+               edgeCount() * (sizeof(unsigned) + sizeof(uint64_t)) + potential.size() * sizeof(long long);
+    }
+};
+
+#endif //VE281P4_CONTRACTION_HIERARCHY_HPP
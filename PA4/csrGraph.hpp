@@ -0,0 +1,115 @@
+#ifndef VE281P4_CSR_GRAPH_HPP
+#define VE281P4_CSR_GRAPH_HPP
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * A directed edge as it appears in the input
+ */
+struct Edge {
+    unsigned from;
+    unsigned to;
+    int weight;
+};
+
+/**
+ * A directed graph in compressed sparse row form
+ * The out-edges of vertex u are the indices [begin(u), end(u)) of two flat arrays, sorted by target,
+ * so a traversal reads them sequentially: 4 bytes per edge for the target plus the weight
+ * @tparam W weight type
+ */
+template<typename W>
+class CSRGraph {
+    std::vector<size_t> offsets;    // offsets[u] is the first edge of u, offsets[V] = number of edges
+    std::vector<unsigned> targets;
+    std::vector<W> weights;
+
+public:
+    CSRGraph() : offsets(1, 0) {}
+
+    /**
+     * Build from an edge list with two stable counting sorts, by target and then by source
+     * If an edge appears several times, the last one wins, as in the dense matrix
+     * Time Complexity: O(V + E)
+     * @param V number of vertices
+     * @param edges
+     */
+    CSRGraph(size_t V, const std::vector<Edge> &edges) : offsets(V + 1, 0) {
+        std::vector<size_t> byTarget(V + 1, 0);
+        for (auto &edge : edges) byTarget[edge.to + 1]++;
+        for (size_t v = 0; v < V; v++) byTarget[v + 1] += byTarget[v];
+        std::vector<size_t> order(edges.size());
+        for (size_t e = 0; e < edges.size(); e++) order[byTarget[edges[e].to]++] = e;
+
+        for (auto &edge : edges) offsets[edge.from + 1]++;
+        for (size_t u = 0; u < V; u++) offsets[u + 1] += offsets[u];
+        std::vector<size_t> sorted(edges.size());
+        std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+        for (size_t e : order) sorted[next[edges[e].from]++] = e;
+
+        // duplicates are now adjacent and in input order, keep the last of each run
+        targets.reserve(edges.size());
+        weights.reserve(edges.size());
+        size_t kept = 0;
+        for (size_t u = 0; u < V; u++) {
+            size_t first = offsets[u], last = offsets[u + 1];
+            offsets[u] = kept;
+            for (size_t i = first; i < last; i++) {
+                const Edge &edge = edges[sorted[i]];
+                if (i + 1 < last && edges[sorted[i + 1]].to == edge.to) continue;
+                targets.push_back(edge.to);
+                weights.push_back((W) edge.weight);
+                kept++;
+            }
+        }
+        offsets[V] = kept;
+        targets.shrink_to_fit();
+        weights.shrink_to_fit();
+    }
+
+    size_t vertexCount() const { return offsets.size() - 1; }
+
+    size_t edgeCount() const { return targets.size(); }
+
+    size_t begin(size_t u) const { return offsets[u]; }
+
+    size_t end(size_t u) const { return offsets[u + 1]; }
+
+    unsigned target(size_t e) const { return targets[e]; }
+
+    W weight(size_t e) const { return weights[e]; }
+
+    /**
+     * @return the graph with every edge reversed
+     * Time Complexity: O(V + E)
+     */
+    CSRGraph reversed() const {
+        CSRGraph result;
+        size_t V = vertexCount();
+        result.offsets.assign(V + 1, 0);
+        result.targets.resize(edgeCount());
+        result.weights.resize(edgeCount());
+        for (unsigned v : targets) result.offsets[v + 1]++;
+        for (size_t v = 0; v < V; v++) result.offsets[v + 1] += result.offsets[v];
+        std::vector<size_t> next(result.offsets.begin(), result.offsets.end() - 1);
+        for (size_t u = 0; u < V; u++) {
+            for (size_t e = begin(u); e < end(u); e++) {
+                size_t slot = next[targets[e]]++;
+                result.targets[slot] = (unsigned) u;
+                result.weights[slot] = weights[e];
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @return bytes used by the arrays
+     */
+    size_t memoryBytes() const {
+        return offsets.capacity() * sizeof(size_t) + targets.capacity() * sizeof(unsigned) +
+               weights.capacity() * sizeof(W);
+    }
+};
+
+#endif //VE281P4_CSR_GRAPH_HPP
@@ -0,0 +1,101 @@
+#ifndef VE281P4_DISTANCE_MATRIX_HPP
+#define VE281P4_DISTANCE_MATRIX_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <utility>
+
+/**
+ * A V x V matrix of distances in one contiguous, cache line aligned allocation
+ * Rows and columns are padded to a multiple of the tile size with unreachable vertices,
+ * so that the blocked Floyd–Warshall only ever works on full tiles and every row starts on a cache line
+ * The largest value of T is the INF sentinel
+ * @tparam T distance type
+ */
+template<typename T>
+class DistanceMatrix {
+public:
+    typedef T value_type;
+
+    static constexpr size_t ALIGNMENT = 64;
+    static constexpr T INF = std::numeric_limits<T>::max();
+
+private:
+    size_t n = 0;           // number of vertices
+    size_t stride = 0;      // padded number of vertices, the length of a row
+    T *data = nullptr;
+
+    static T *allocate(size_t count) {
+        return count ? static_cast<T *>(::operator new(count * sizeof(T), std::align_val_t(ALIGNMENT))) : nullptr;
+    }
+
+    void release() {
+        if (data) ::operator delete(data, std::align_val_t(ALIGNMENT));
+        data = nullptr;
+    }
+
+public:
+    DistanceMatrix() = default;
+
+    /**
+     * A matrix of n vertices with no edges: 0 on the diagonal and INF elsewhere
+     * Time Complexity: O(stride^2)
+     * @param n
+     * @param tile rows and columns are padded to a multiple of tile
+     */
+    explicit DistanceMatrix(size_t n, size_t tile = 1) : n(n), stride((n + tile - 1) / tile * tile) {
+        data = allocate(stride * stride);
+        std::fill(data, data + stride * stride, INF);
+        for (size_t i = 0; i < stride; i++) data[i * stride + i] = 0;
+    }
+
+    /**
+     * @return bytes a matrix of n vertices allocates, without allocating it
+     */
+    static size_t bytes(size_t n, size_t tile = 1) {
+        size_t padded = (n + tile - 1) / tile * tile;
+        return padded * padded * sizeof(T);
+    }
+
+    DistanceMatrix(const DistanceMatrix &that) : n(that.n), stride(that.stride) {
+        data = allocate(stride * stride);
+        std::copy(that.data, that.data + stride * stride, data);
+    }
+
+    DistanceMatrix(DistanceMatrix &&that) noexcept { swap(that); }
+
+    DistanceMatrix &operator=(DistanceMatrix that) noexcept {
+        swap(that);
+        return *this;
+    }
+
+    ~DistanceMatrix() { release(); }
+
+    void swap(DistanceMatrix &that) noexcept {
+        std::swap(n, that.n);
+        std::swap(stride, that.stride);
+        std::swap(data, that.data);
+    }
+
+    /**
+     * @return number of vertices
+     */
+    size_t size() const { return n; }
+
+    /**
+     * @return padded number of vertices, also the distance in elements between two rows
+     */
+    size_t paddedSize() const { return stride; }
+
+    T *row(size_t i) { return data + i * stride; }
+
+    const T *row(size_t i) const { return data + i * stride; }
+
+    T &operator()(size_t i, size_t j) { return data[i * stride + j]; }
+
+    const T &operator()(size_t i, size_t j) const { return data[i * stride + j]; }
+};
+
+#endif //VE281P4_DISTANCE_MATRIX_HPP
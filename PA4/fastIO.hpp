@@ -0,0 +1,332 @@
+#ifndef VE281P4_FAST_IO_HPP
+#define VE281P4_FAST_IO_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Bulk input and buffered output for graphs with up to hundreds of millions of edges
+ * Reader maps a regular file (or reads a pipe in 1 MB blocks) and parses integers by hand:
+ * up to 8 digits are found and combined at once inside one 64-bit word (SWAR), without a loop over the digits
+ * Writer formats integers into a 64 KB buffer and only writes it out when full or flushed,
+ * instead of flushing after every line like std::endl
+ * A graph can also be stored in a binary edge list, which is read with plain copies:
+ *   "VE281P4E", uint64 V, uint64 E, then E records of {uint32 from, uint32 to, int32 weight}, in host byte order
+ */
+namespace FastIO {
+    inline constexpr char BINARY_MAGIC[8] = {'V', 'E', '2', '8', '1', 'P', '4', 'E'};
+
+    class Reader {
+        static constexpr size_t BLOCK = 1 << 20;
+        static constexpr size_t LOOKAHEAD = 32;     // longer than any integer, so one never straddles a refill
+
+        int fd;
+        char *mapping = nullptr;
+        size_t mappingSize = 0;
+        std::vector<char> buffer;
+        const char *pos = nullptr, *end = nullptr;
+        bool exhausted = false;     // nothing more to read from fd
+
+        /**
+         * Keep the unread bytes and fill the rest of the buffer
+         */
+        void refill() {
+            if (exhausted) return;
+            size_t remaining = (size_t) (end - pos);
+            std::memmove(buffer.data(), pos, remaining);
+            size_t filled = remaining;
+            while (filled < buffer.size()) {
+                ssize_t count = ::read(fd, buffer.data() + filled, buffer.size() - filled);
+                if (count <= 0) {
+                    exhausted = true;
+                    break;
+                }
+                filled += (size_t) count;
+            }
+            pos = buffer.data();
+            end = pos + filled;
+        }
+
+        void ensure(size_t count) {
+            if ((size_t) (end - pos) < count) refill();
+        }
+
+        /**
+         * Value of the leading digits of the 8 bytes at p, and their count, on a little-endian machine
+         * Time Complexity: O(1), a handful of 64-bit operations
+         */
+        static uint64_t parseEight(const char *p, size_t &digits) {
+            uint64_t chunk;
+            std::memcpy(&chunk, p, 8);
+            uint64_t value = chunk ^ 0x3030303030303030ull;     // digit bytes become 0 to 9
+            // high bit of every byte that is not a digit; carries only run past the first such byte
+            uint64_t nonDigit = ((value + 0x7676767676767676ull) | value) & 0x8080808080808080ull;
+            digits = nonDigit ? (size_t) __builtin_ctzll(nonDigit) / 8 : 8;
+            if (digits == 0) return 0;
+            value <<= 8 * (8 - digits);     // left pad with zero digits
+            // combine adjacent digits into pairs, pairs into quadruples, and those into the result
+            value = ((value * (1 + (10ull << 8))) >> 8) & 0x00FF00FF00FF00FFull;
+            value = ((value * (1 + (100ull << 16))) >> 16) & 0x0000FFFF0000FFFFull;
+            return (value * (1 + (10000ull << 32))) >> 32;
+        }
+
+    public:
+        /**
+         * @param fd file descriptor to read from, mapped if it is a regular file
+         */
+        explicit Reader(int fd) : fd(fd) {
+            struct stat status{};
+            if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0) {
+                off_t offset = lseek(fd, 0, SEEK_CUR);
+                void *address = mmap(nullptr, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (address != MAP_FAILED && offset >= 0) {
+                    mapping = static_cast<char *>(address);
+                    mappingSize = (size_t) status.st_size;
+                    pos = mapping + std::min((size_t) offset, mappingSize);
+                    end = mapping + mappingSize;
+                    exhausted = true;
+                    madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+                    return;
+                }
+                if (address != MAP_FAILED) munmap(address, (size_t) status.st_size);
+            }
+            buffer.resize(BLOCK);
+            pos = end = buffer.data();
+        }
+
+        Reader(const Reader &) = delete;
+
+        Reader &operator=(const Reader &) = delete;
+
+        ~Reader() {
+            if (mapping) munmap(mapping, mappingSize);
+        }
+
+        /**
+         * Skip whitespace
+         * @return false at the end of the input
+         */
+        bool skipSpace() {
+            while (true) {
+                while (pos < end && (unsigned char) *pos <= ' ') pos++;
+                if (pos < end) return true;
+                if (exhausted) return false;
+                refill();
+            }
+        }
+
+        /**
+         * Read the next integer in decimal, with an optional minus sign
+         * Time Complexity: O(number of digits / 8)
+         * @return false at the end of the input, or if the next token is not a number
+         */
+        template<typename T>
+        bool read(T &result) {
+            static_assert(std::is_integral<T>::value, "only integers are parsed");
+            if (!skipSpace()) return false;
+            ensure(LOOKAHEAD);
+            bool negative = *pos == '-';
+            if (negative || *pos == '+') pos++;
+            const char *start = pos;
+            uint64_t value = 0;
+            size_t digits = 8;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            while (digits == 8 && end - pos >= 8) {
+                uint64_t part = parseEight(pos, digits);
+                static const uint64_t scale[9] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+                value = value * scale[digits] + part;
+                pos += digits;
+            }
+#endif
+            // the last few bytes of the input, or all digits on a big-endian machine
+            if (digits == 8) {
+                while (pos < end && *pos >= '0' && *pos <= '9') value = value * 10 + (uint64_t) (*pos++ - '0');
+            }
+            if (pos == start) return false;     // not a number
+            result = negative ? (T) (0 - value) : (T) value;
+            return true;
+        }
+
+        /**
+         * @return whether the next bytes equal prefix, without consuming them
+         */
+        bool startsWith(const char *prefix, size_t length) {
+            ensure(length);
+            return (size_t) (end - pos) >= length && std::memcmp(pos, prefix, length) == 0;
+        }
+
+        /**
+         * Copy the next count bytes
+         * @return false if the input ends first
+         */
+        bool readBytes(void *destination, size_t count) {
+            char *out = static_cast<char *>(destination);
+            while (count > 0) {
+                if (pos == end) {
+                    if (exhausted) return false;
+                    refill();
+                    continue;
+                }
+                size_t chunk = std::min(count, (size_t) (end - pos));
+                std::memcpy(out, pos, chunk);
+                out += chunk;
+                pos += chunk;
+                count -= chunk;
+            }
+            return true;
+        }
+    };
+
+    class Writer {
+        static constexpr size_t BLOCK = 1 << 16;
+
+        int fd;
+        char buffer[BLOCK];
+        size_t used = 0;
+
+    public:
+        explicit Writer(int fd) : fd(fd) {}
+
+        Writer(const Writer &) = delete;
+
+        Writer &operator=(const Writer &) = delete;
+
+        ~Writer() { flush(); }
+
+        void flush() {
+            size_t written = 0;
+            while (written < used) {
+                ssize_t count = ::write(fd, buffer + written, used - written);
+                if (count <= 0) break;
+                written += (size_t) count;
+            }
+            used = 0;
+        }
+
+        void write(const char *text, size_t length) {
+            if (used + length > BLOCK) flush();
+            if (length > BLOCK) {
+                for (size_t written = 0; written < length;) {
+                    ssize_t count = ::write(fd, text + written, length - written);
+                    if (count <= 0) return;
+                    written += (size_t) count;
+                }
+                return;
+            }
+            std::memcpy(buffer + used, text, length);
+            used += length;
+        }
+
+        void write(const char *text) { write(text, std::strlen(text)); }
+
+        void put(char c) {
+            if (used == BLOCK) flush();
+            buffer[used++] = c;
+        }
+
+        /**
+         * Time Complexity: O(number of digits)
+         */
+        void write(long long value) {
+            if (used + 24 > BLOCK) flush();
+            uint64_t magnitude = value < 0 ? 0 - (uint64_t) value : (uint64_t) value;
+            char digits[20];
+            size_t count = 0;
+            do {
+                digits[count++] = (char) ('0' + magnitude % 10);
+                magnitude /= 10;
+            } while (magnitude > 0);
+            if (value < 0) buffer[used++] = '-';
+            while (count > 0) buffer[used++] = digits[--count];
+        }
+    };
+
+    /**
+     * The reader of the standard input, shared by everything that parses it
+     */
+    inline Reader &input() {
+        static Reader reader(STDIN_FILENO);
+        return reader;
+    }
+
+    /**
+     * The writer of the standard output, flushed at exit
+     */
+    inline Writer &output() {
+        static Writer writer(STDOUT_FILENO);
+        return writer;
+    }
+
+    /**
+     * Read the number of vertices and edges of a graph in text or in the binary edge list format
+     * @return false if the input ends first
+     */
+    inline bool readGraphHeader(Reader &reader, uint64_t &V, uint64_t &E, bool &binary) {
+        binary = reader.startsWith(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+        if (!binary) return reader.read(V) && reader.read(E);
+        char magic[sizeof(BINARY_MAGIC)];
+        return reader.readBytes(magic, sizeof(magic)) && reader.readBytes(&V, sizeof(V)) &&
+               reader.readBytes(&E, sizeof(E));
+    }
+
+    /**
+     * Read E edges following readGraphHeader, calling visit(from, to, weight) for each
+     * Time Complexity: O(E)
+     * @throw std::runtime_error if the input ends first
+     */
+    template<typename Visitor>
+    void readEdges(Reader &reader, uint64_t E, bool binary, Visitor visit) {
+        if (!binary) {
+            for (uint64_t e = 0; e < E; e++) {
+                unsigned from, to;
+                int weight;
+                if (!reader.read(from) || !reader.read(to) || !reader.read(weight)) {
+                    throw std::runtime_error("the input ends after " + std::to_string(e) + " edges");
+                }
+                visit(from, to, weight);
+            }
+            return;
+        }
+        uint32_t records[4096][3];
+        for (uint64_t e = 0; e < E;) {
+            size_t count = (size_t) std::min<uint64_t>(E - e, 4096);
+            if (!reader.readBytes(records, count * sizeof(records[0]))) {
+                throw std::runtime_error("the input ends after " + std::to_string(e) + " edges");
+            }
+            for (size_t i = 0; i < count; i++) visit(records[i][0], records[i][1], (int) records[i][2]);
+            e += count;
+        }
+    }
+
+    /**
+     * Save a graph in the binary edge list format
+     * @throw std::runtime_error if the file can not be written
+     */
+    template<typename EdgeType>
+    void writeBinaryGraph(const std::string &path, uint64_t V, const std::vector<EdgeType> &edges) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) throw std::runtime_error("can not open " + path);
+        uint64_t E = edges.size();
+        file.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+        file.write(reinterpret_cast<const char *>(&V), sizeof(V));
+        file.write(reinterpret_cast<const char *>(&E), sizeof(E));
+        for (auto &edge : edges) {
+            uint32_t record[3] = {edge.from, edge.to, (uint32_t) edge.weight};
+            file.write(reinterpret_cast<const char *>(record), sizeof(record));
+        }
+        if (!file) throw std::runtime_error("can not write " + path);
+    }
+}
+
+#endif //VE281P4_FAST_IO_HPP
@@ -0,0 +1,558 @@
+#ifndef VE281P4_FLOYD_WARSHALL_HPP
+#define VE281P4_FLOYD_WARSHALL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "distanceMatrix.hpp"
+
+/**
+ * Blocked Floyd–Warshall on a DistanceMatrix
+ * The matrix is split into TILE x TILE tiles, and round kb of the outer loop relaxes every tile through
+ * the vertices of the kb-th block: first the diagonal tile (kb, kb), which only depends on itself,
+ * then the tiles in row kb and column kb, which depend on the diagonal tile, and finally all remaining tiles,
+ * which depend on one row tile and one column tile
+ * The three tiles touched by an update fit in L1/L2 cache, instead of streaming the whole matrix once per vertex
+ * The innermost loop is a branch-free min-plus over one tile row with a compile-time trip count,
+ * which the compiler vectorizes (at -O3, with -mavx2 or -march=native for 8 ints per instruction)
+ * Within a phase the tiles are independent, so the parallel version splits each phase among threads
+ * and separates the phases with barriers
+ * Sums are checked for overflow on the fly, so narrow distance types (16 bits for half the memory of int)
+ * either give exact distances or report Status::Overflow, never silently wrapped ones; runWidening then runs
+ * again in a wider type, and only fails if a shortest distance itself does not fit
+ * A run reports its progress after every round, and can be cancelled between rounds
+ */
+namespace FloydWarshall {
+    static constexpr size_t TILE = 64;
+
+    /**
+     * a + b with two's complement wrap-around instead of undefined behavior on overflow
+     */
+    template<typename T>
+    inline T wrapAdd(T a, T b) {
+        typedef typename std::make_unsigned<T>::type Unsigned;
+        return (T) ((Unsigned) a + (Unsigned) b);
+    }
+
+    /**
+     * The outcome of a run
+     */
+    enum class Status {
+        Done,
+        NegativeCycle,  // some vertex lies on a negative cycle, and the distances are meaningless
+        Overflow,       // some sum did not fit in the distance type, and the distances are meaningless
+        Cancelled       // stopped by the progress callback, and the distances are meaningless
+    };
+
+    /**
+     * Called with (rounds done, rounds) after each round of a run, on the calling thread;
+     * returning false cancels the run before the next round
+     */
+    typedef std::function<bool(size_t, size_t)> Progress;
+
+    /**
+     * Relax one tile row i through vertex k: rowI[j] = min(rowI[j], dist[i][k] + rowK[j])
+     * Unless checked, no sum may overflow; otherwise sums are compared against a limit computed once per row:
+     * for dist[i][k] >= 0, rowK[j] >= INF - dist[i][k] exactly when the sum reaches INF (rowK[j] = INF included),
+     * and for dist[i][k] < 0, rowK[j] < MIN - dist[i][k] exactly when it falls below the smallest T
+     * A sum that does not fit is lost if it may be needed: always below MIN, and at INF or above only towards
+     * an entry that is still INF; this may report a path that a later block would have shortened enough,
+     * which runWidening settles in a wider type, but never misses a distance that does not fit
+     * The loops are branch-free and vectorized, the tests of checked and nextI are hoisted out of them
+     * Time Complexity: O(TILE)
+     * @return nonzero if some sum is lost
+     */
+    template<typename T, typename Hop>
+    inline T relaxRow(T throughK, const T *rowK, T *rowI, Hop hop, Hop *nextI, bool checked) {
+        constexpr T INF = DistanceMatrix<T>::INF, MIN = std::numeric_limits<T>::min();
+        if (!checked) {
+            for (size_t j = 0; j < TILE; j++) {
+                T candidate = rowK[j] == INF ? INF : wrapAdd(throughK, rowK[j]);
+                bool better = candidate < rowI[j];
+                rowI[j] = better ? candidate : rowI[j];
+                if (nextI) nextI[j] = better ? hop : nextI[j];
+            }
+            return 0;
+        }
+        // accumulated in T with bitwise operations on bools, without branches
+        T lost = 0;
+        if (throughK >= 0) {
+            T limit = (T) (INF - throughK);
+            for (size_t j = 0; j < TILE; j++) {
+                T weight = rowK[j], current = rowI[j];
+                T candidate = weight < limit ? wrapAdd(throughK, weight) : INF;
+                lost |= (T) ((weight >= limit) & (weight != INF) & (current == INF));
+                bool better = candidate < current;
+                rowI[j] = better ? candidate : current;
+                if (nextI) nextI[j] = better ? hop : nextI[j];
+            }
+        } else {
+            T limit = (T) (MIN - throughK);
+            for (size_t j = 0; j < TILE; j++) {
+                T weight = rowK[j], current = rowI[j];
+                T candidate = (weight == INF) | (weight < limit) ? INF : wrapAdd(throughK, weight);
+                lost |= (T) (weight < limit);
+                bool better = candidate < current;
+                rowI[j] = better ? candidate : current;
+                if (nextI) nextI[j] = better ? hop : nextI[j];
+            }
+        }
+        return lost;
+    }
+
+    /**
+     * Relax tile (ib, jb) through the vertices of block kb
+     * Rows with dist[i][k] = INF are skipped once, outside the inner loop;
+     * dist[k][j] = INF is filtered with a select, so INF never takes part in a sum that could be chosen
+     * If checked, overflow is checked in the rows where dist[i][k] plus the largest or smallest finite rowK[j]
+     * does not fit, which are rare unless T is narrow for the graph
+     * With a next hop matrix, next[i][j] follows every improvement of dist[i][j] to next[i][k]
+     * Time Complexity: O(TILE^3)
+     * @param dist
+     * @param next next hop matrix, or nullptr
+     * @param ib first row of the tile
+     * @param jb first column of the tile
+     * @param kb first vertex of the block
+     * @param checked false if no sum can overflow, see mayOverflow
+     * @return whether some distance does not fit in T
+     */
+    template<typename T, typename Hop>
+    bool relaxTile(DistanceMatrix<T> &dist, DistanceMatrix<Hop> *next, size_t ib, size_t jb, size_t kb,
+                   bool checked) {
+        constexpr T INF = DistanceMatrix<T>::INF, MIN = std::numeric_limits<T>::min();
+        T lost = 0;
+        for (size_t k = kb; k < kb + TILE; k++) {
+            const T *rowK = dist.row(k) + jb;
+            // range of the finite rowK[j]; INF wraps around to MIN instead of a select, which does not vectorize
+            T low = INF, high = MIN;
+            for (size_t j = 0; checked && j < TILE; j++) {
+                low = std::min(low, rowK[j]);
+                high = std::max(high, wrapAdd(rowK[j], (T) (rowK[j] == INF)));
+            }
+            for (size_t i = ib; i < ib + TILE; i++) {
+                // row k itself can only change through a negative dist[k][k], which is reported after the round
+                T throughK = dist(i, k);
+                if (throughK == INF || i == k) continue;
+                bool checkRow = checked && (throughK >= 0 ? high >= (T) (INF - throughK) : low < (T) (MIN - throughK));
+                if (next) lost |= relaxRow(throughK, rowK, dist.row(i) + jb, (*next)(i, k), next->row(i) + jb, checkRow);
+                else lost |= relaxRow(throughK, rowK, dist.row(i) + jb, (Hop) 0, (Hop *) nullptr, checkRow);
+            }
+        }
+        return lost != 0;
+    }
+
+    /**
+     * Relax all tiles through block kb, in the dependency order of the three phases
+     * Time Complexity: O(V^2 * TILE)
+     * @return whether some distance does not fit in T
+     */
+    template<typename T, typename Hop>
+    bool relaxRound(DistanceMatrix<T> &dist, DistanceMatrix<Hop> *next, size_t kb, bool checked) {
+        size_t padded = dist.paddedSize();
+        bool lost = relaxTile(dist, next, kb, kb, kb, checked);
+        for (size_t b = 0; b < padded; b += TILE) {
+            if (b == kb) continue;
+            lost |= relaxTile(dist, next, kb, b, kb, checked);
+            lost |= relaxTile(dist, next, b, kb, kb, checked);
+        }
+        for (size_t ib = 0; ib < padded; ib += TILE) {
+            if (ib == kb) continue;
+            for (size_t jb = 0; jb < padded; jb += TILE) {
+                if (jb != kb) lost |= relaxTile(dist, next, ib, jb, kb, checked);
+            }
+        }
+        return lost;
+    }
+
+    /**
+     * Whether a sum could overflow: a path has at most V - 1 edges, so if (V - 1) * max |weight| fits in T,
+     * no distance and no sum of two of them ever leaves the range of T
+     * Time Complexity: O(V^2)
+     * @param dist edge weights
+     */
+    template<typename T>
+    bool mayOverflow(const DistanceMatrix<T> &dist) {
+        constexpr T INF = DistanceMatrix<T>::INF;
+        uint64_t largest = 0;
+        for (size_t i = 0; i < dist.size(); i++) {
+            for (size_t j = 0; j < dist.size(); j++) {
+                T weight = dist(i, j);
+                if (weight == INF) continue;
+                uint64_t magnitude = weight < 0 ? 0 - (uint64_t) weight : (uint64_t) weight;
+                largest = std::max(largest, magnitude);
+            }
+        }
+        // two sums of up to V - 1 edges each are added before the candidate is compared, and INF is reserved
+        uint64_t edges = 2 * (uint64_t) dist.size();
+        return largest > 0 && edges > ((uint64_t) INF - 1) / largest;
+    }
+
+    /**
+     * @return whether some vertex lies on a negative cycle found so far
+     */
+    template<typename T>
+    bool hasNegativeCycle(const DistanceMatrix<T> &dist) {
+        for (size_t i = 0; i < dist.size(); i++) {
+            if (dist(i, i) < 0) return true;
+        }
+        return false;
+    }
+
+    /**
+     * A reusable barrier for a fixed number of threads (std::barrier is C++20)
+     */
+    class Barrier {
+        std::mutex mutex;
+        std::condition_variable released;
+        size_t threads;
+        size_t waiting = 0;
+        size_t generation = 0;
+
+    public:
+        explicit Barrier(size_t threads) : threads(threads) {}
+
+        /**
+         * Block until all threads have arrived, writes made before arriving are visible to all threads after it
+         */
+        void arriveAndWait() {
+            std::unique_lock<std::mutex> lock(mutex);
+            size_t current = generation;
+            if (++waiting == threads) {
+                waiting = 0;
+                generation++;
+                released.notify_all();
+            } else {
+                released.wait(lock, [&] { return generation != current; });
+            }
+        }
+    };
+
+    /**
+     * Rounds of relaxRound shared among threads
+     * Thread t relaxes the tiles t, t + threads, ... of each phase, the diagonal tile is relaxed by thread 0,
+     * and each thread checks the diagonals of its own tiles for a negative cycle
+     * Thread 0 also reports progress before starting a round, and every thread reads its answer after the
+     * first barrier, so all of them stop at the same round
+     * Time Complexity: O(V^3 / threads + V^2 / TILE * threads) for the barriers
+     */
+    template<typename T, typename Hop>
+    void relaxRoundsParallel(DistanceMatrix<T> &dist, DistanceMatrix<Hop> *next, bool checked, size_t thread,
+                             size_t threads, Barrier &barrier, std::atomic<bool> &negative,
+                             std::atomic<bool> &overflow, const Progress &progress, std::atomic<bool> &cancelled) {
+        size_t blocks = dist.paddedSize() / TILE;
+        auto checkDiagonal = [&](size_t b) {
+            for (size_t i = b * TILE; i < std::min((b + 1) * TILE, dist.size()); i++) {
+                if (dist(i, i) < 0) negative.store(true, std::memory_order_relaxed);
+            }
+        };
+        for (size_t k = 0; k < blocks; k++) {
+            bool lost = false;
+            if (thread == 0 && k > 0 && progress && !progress(k, blocks)) {
+                cancelled.store(true, std::memory_order_relaxed);
+            }
+            if (thread == 0 && !cancelled.load(std::memory_order_relaxed)) {
+                lost = relaxTile(dist, next, k * TILE, k * TILE, k * TILE, checked);
+            }
+            barrier.arriveAndWait();
+            if (cancelled.load(std::memory_order_relaxed)) return;
+            // the flag is only set after the first barrier, when every thread has read it in the previous round
+            if (thread == 0) checkDiagonal(k);
+            // tiles 2c and 2c + 1 are (k, b) and (b, k), where b is the c-th block other than k
+            for (size_t t = thread; t < 2 * (blocks - 1); t += threads) {
+                size_t b = t / 2 + (t / 2 >= k);
+                if (t % 2 == 0) lost |= relaxTile(dist, next, k * TILE, b * TILE, k * TILE, checked);
+                else lost |= relaxTile(dist, next, b * TILE, k * TILE, k * TILE, checked);
+            }
+            barrier.arriveAndWait();
+            // the (blocks - 1)^2 tiles outside row and column k, in row-major order
+            for (size_t t = thread; t < (blocks - 1) * (blocks - 1); t += threads) {
+                size_t ib = t / (blocks - 1), jb = t % (blocks - 1);
+                ib += ib >= k;
+                jb += jb >= k;
+                lost |= relaxTile(dist, next, ib * TILE, jb * TILE, k * TILE, checked);
+                if (ib == jb) checkDiagonal(ib);
+            }
+            if (lost) overflow.store(true, std::memory_order_relaxed);
+            barrier.arriveAndWait();
+            if (negative.load(std::memory_order_relaxed)) return;
+        }
+        if (thread == 0 && progress) progress(blocks, blocks);
+    }
+
+    /**
+     * All-pairs shortest distances in place, optionally with the next hop of every shortest path
+     * Stops early after the first round that closes a negative cycle
+     * After an overflow it goes on, since a negative cycle takes precedence: sums that do not fit are never chosen,
+     * so a negative cycle found later is real
+     * Time Complexity: O(V^3 / threads)
+     * @param dist edge weights on input, shortest distances on output; must be padded to a multiple of TILE
+     * @param next nextHops(dist) on input, next hops on output, or nullptr
+     * @param threads number of threads, 0 for one per hardware thread
+     * @param progress called after each of the V / TILE rounds, or empty
+     */
+    template<typename T, typename Hop>
+    Status run(DistanceMatrix<T> &dist, DistanceMatrix<Hop> *next, size_t threads, const Progress &progress = nullptr) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        // phase 3 of a round has (blocks - 1)^2 tiles, more threads than that would only wait at the barriers
+        size_t blocks = dist.paddedSize() / TILE;
+        threads = std::min(threads, std::max<size_t>(1, (blocks - 1) * (blocks - 1)));
+        bool checked = mayOverflow(dist);
+        if (threads <= 1) {
+            bool lost = false;
+            for (size_t k = 0; k < blocks; k++) {
+                lost |= relaxRound(dist, next, k * TILE, checked);
+                if (hasNegativeCycle(dist)) return Status::NegativeCycle;
+                if (progress && !progress(k + 1, blocks) && k + 1 < blocks) return Status::Cancelled;
+            }
+            return lost ? Status::Overflow : Status::Done;
+        }
+        Barrier barrier(threads);
+        std::atomic<bool> negative{false}, overflow{false}, cancelled{false};
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                relaxRoundsParallel(dist, next, checked, t, threads, barrier, negative, overflow, progress, cancelled);
+            });
+        }
+        relaxRoundsParallel(dist, next, checked, 0, threads, barrier, negative, overflow, progress, cancelled);
+        for (auto &worker : workers) worker.join();
+        if (negative) return Status::NegativeCycle;
+        if (cancelled) return Status::Cancelled;
+        return overflow ? Status::Overflow : Status::Done;
+    }
+
+    /**
+     * All-pairs shortest distances in place, without paths
+     * Time Complexity: O(V^3 / threads)
+     * @param dist edge weights on input, shortest distances on output; must be padded to a multiple of TILE
+     * @param threads number of threads, 0 for one per hardware thread
+     */
+    template<typename T>
+    Status run(DistanceMatrix<T> &dist, size_t threads = 1) {
+        return run(dist, (DistanceMatrix<uint16_t> *) nullptr, threads);
+    }
+
+    /**
+     * The next hop matrix of a graph before run: next[i][j] = j for every edge, i on the diagonal,
+     * and INF of Hop where there is no edge
+     * Time Complexity: O(V^2)
+     * @tparam Hop vertex type, its largest value must exceed the padded size of dist
+     * @param dist edge weights
+     */
+    template<typename Hop, typename T>
+    DistanceMatrix<Hop> nextHops(const DistanceMatrix<T> &dist) {
+        DistanceMatrix<Hop> next(dist.size(), TILE);
+        for (size_t i = 0; i < dist.paddedSize(); i++) {
+            for (size_t j = 0; j < dist.paddedSize(); j++) {
+                next(i, j) = i == j ? (Hop) i : dist(i, j) == DistanceMatrix<T>::INF ? DistanceMatrix<Hop>::INF : (Hop) j;
+            }
+        }
+        return next;
+    }
+
+    /**
+     * run, and if some sum does not fit in T, run again in Wide and narrow the distances back to T
+     * A sum lost by run may belong to a path that a later vertex shortens enough to fit, so Overflow from run
+     * alone does not mean that a shortest distance does not fit; here it does
+     * The input is copied first whenever a sum may overflow, and the failed distances are freed before
+     * the wider matrix is allocated, so the run in Wide holds a T and a Wide matrix
+     * Time Complexity: O(V^3 / threads), twice when the wider run is needed
+     * @tparam Wide a wider distance type, or T itself for a plain run
+     * @param dist edge weights on input, shortest distances on output; must be padded to a multiple of TILE
+     * @param next nextHops(dist) on input, next hops on output, or nullptr
+     * @param progress as in run, counting the rounds of the wider run again from 0
+     */
+    template<typename Wide, typename T, typename Hop>
+    Status runWidening(DistanceMatrix<T> &dist, DistanceMatrix<Hop> *next, size_t threads,
+                       const Progress &progress = nullptr) {
+        constexpr T INF = DistanceMatrix<T>::INF, MIN = std::numeric_limits<T>::min();
+        if (std::is_same<Wide, T>::value || !mayOverflow(dist)) return run(dist, next, threads, progress);
+        DistanceMatrix<T> edges = dist;
+        Status status = run(dist, next, threads, progress);
+        if (status != Status::Overflow) return status;
+        dist = DistanceMatrix<T>();
+        DistanceMatrix<Wide> wide(edges.size(), TILE);
+        for (size_t i = 0; i < edges.paddedSize(); i++) {
+            for (size_t j = 0; j < edges.paddedSize(); j++) {
+                wide(i, j) = edges(i, j) == INF ? DistanceMatrix<Wide>::INF : (Wide) edges(i, j);
+            }
+        }
+        if (next) *next = nextHops<Hop>(wide);
+        status = run(wide, next, threads, progress);
+        // the distances are narrowed into the copy of the input, which is meaningless after a failure as well
+        for (size_t i = 0; i < wide.paddedSize() && status == Status::Done; i++) {
+            for (size_t j = 0; j < wide.paddedSize(); j++) {
+                Wide d = wide(i, j);
+                if (d != DistanceMatrix<Wide>::INF && (d < MIN || d >= INF)) {
+                    status = Status::Overflow;
+                    break;
+                }
+                edges(i, j) = d == DistanceMatrix<Wide>::INF ? INF : (T) d;
+            }
+        }
+        dist.swap(edges);
+        return status;
+    }
+
+    /**
+     * The vertices of a shortest path after run, by following next hops
+     * Time Complexity: O(length of the path)
+     * @return A, ..., B, or nothing if B can not be reached from A
+     */
+    template<typename T, typename Hop>
+    std::vector<unsigned> path(const DistanceMatrix<T> &dist, const DistanceMatrix<Hop> &next, unsigned A, unsigned B) {
+        std::vector<unsigned> vertices;
+        if (dist(A, B) == DistanceMatrix<T>::INF) return vertices;
+        vertices.push_back(A);
+        // a shortest path never repeats a vertex once there are no negative cycles, the bound only guards misuse
+        while (A != B && vertices.size() <= dist.size()) {
+            A = next(A, B);
+            vertices.push_back(A);
+        }
+        return vertices;
+    }
+
+    /**
+     * Repair shortest distances after edge (u, v) got a weight below dist[u][v], or was added
+     * Every new shortest path is i ~> u -> v ~> j, so one pass of dist[i][j] = min(dist[i][j], dist[i][u] + w + dist[v][j])
+     * suffices; row v and column u do not change unless the edge closes a negative cycle, which is checked first
+     * The sums are first checked in 128 bits without writing anything, as in relaxRow a sum is lost below MIN,
+     * or at INF or above towards an entry that is still INF; only the rows where dist[i][u] + w plus the smallest
+     * or largest finite dist[v][j] does not fit are checked entry by entry
+     * Time Complexity: O(V^2)
+     * @param dist shortest distances of the graph without the change, repaired in place
+     * @param next next hops of dist, or nullptr
+     * @param weight new weight of the edge
+     * @return NegativeCycle if the edge closes one, or Overflow if some distance does not fit in T,
+     * with dist and next left unchanged in both cases
+     */
+    template<typename T, typename Hop>
+    Status decreaseEdge(DistanceMatrix<T> &dist, DistanceMatrix<Hop> *next, unsigned u, unsigned v, long long weight) {
+        typedef __int128 Wide;  // holds the sum of a weight and two distances of any T
+        constexpr T INF = DistanceMatrix<T>::INF, MIN = std::numeric_limits<T>::min();
+        if (u == v) return weight < 0 ? Status::NegativeCycle : Status::Done;
+        if (dist(v, u) != INF && weight + dist(v, u) < 0) return Status::NegativeCycle;
+        if (weight >= dist(u, v)) return Status::Done;
+        if (weight < MIN) return Status::Overflow;
+        const T *rowV = dist.row(v);
+        T low = INF, high = MIN;
+        for (size_t j = 0; j < dist.size(); j++) {
+            if (rowV[j] == INF) continue;
+            low = std::min(low, rowV[j]);
+            high = std::max(high, rowV[j]);
+        }
+        for (size_t i = 0; i < dist.size(); i++) {
+            if (dist(i, u) == INF) continue;
+            Wide throughEdge = (Wide) dist(i, u) + weight;
+            if (throughEdge + high < INF && throughEdge + low >= MIN) continue;
+            const T *rowI = dist.row(i);
+            for (size_t j = 0; j < dist.size(); j++) {
+                if (rowV[j] == INF) continue;
+                Wide sum = throughEdge + rowV[j];
+                if (sum < MIN || (sum >= INF && rowI[j] == INF)) return Status::Overflow;
+            }
+        }
+        for (size_t i = 0; i < dist.size(); i++) {
+            if (dist(i, u) == INF) continue;
+            Wide throughEdge = (Wide) dist(i, u) + weight;
+            Hop hop = i == u ? (Hop) v : next ? (*next)(i, u) : 0;
+            T *rowI = dist.row(i);
+            Hop *nextI = next ? next->row(i) : nullptr;
+            if (throughEdge >= MIN && throughEdge < INF) {
+                // nothing is lost, the check only keeps sums at INF or above from wrapping around
+                for (size_t jb = 0; jb < dist.paddedSize(); jb += TILE) {
+                    relaxRow((T) throughEdge, rowV + jb, rowI + jb, hop, nextI ? nextI + jb : nullptr, true);
+                }
+                continue;
+            }
+            // dist[i][u] + w itself does not fit, but its sums with some dist[v][j] may
+            for (size_t j = 0; j < dist.size(); j++) {
+                if (rowV[j] == INF || throughEdge + rowV[j] >= rowI[j]) continue;
+                rowI[j] = (T) (throughEdge + rowV[j]);
+                if (nextI) nextI[j] = hop;
+            }
+        }
+        return Status::Done;
+    }
+
+    /**
+     * The pairs whose shortest paths may use edge (u, v) of the given weight: dist[i][u] + weight + dist[v][j] = dist[i][j]
+     * After the weight of the edge increases, only these distances can change
+     * Time Complexity: O(V^2)
+     * @param limit stop after this many pairs
+     * @return false if there are more than limit pairs, and pairs is incomplete
+     */
+    template<typename T>
+    bool affectedPairs(const DistanceMatrix<T> &dist, unsigned u, unsigned v, T weight, size_t limit,
+                       std::vector<std::pair<unsigned, unsigned>> &pairs) {
+        constexpr T INF = DistanceMatrix<T>::INF;
+        pairs.clear();
+        if (weight == INF || dist(u, v) < weight) return true;     // not on any shortest path
+        const T *rowV = dist.row(v);
+        for (size_t i = 0; i < dist.size(); i++) {
+            if (dist(i, u) == INF) continue;
+            long long toV = (long long) dist(i, u) + weight;
+            const T *rowI = dist.row(i);
+            for (size_t j = 0; j < dist.size(); j++) {
+                if (rowV[j] == INF || toV + rowV[j] != rowI[j]) continue;
+                if (pairs.size() == limit) return false;
+                pairs.emplace_back((unsigned) i, (unsigned) j);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Recompute some pairs from scratch while all others are already final:
+     * the pairs restart from direct(i, j), the edge weight (0 on the diagonal, INF without an edge),
+     * then a Floyd–Warshall pass over only these pairs brings them down to the shortest distances,
+     * as dist[i][k] and dist[k][j] are always lengths of paths no longer than those through the first k vertices
+     * The pairs are scattered over the matrix, so their distances are also kept in one array, read in order
+     * once per k, and written through to the matrix only when they improve
+     * Time Complexity: O(pairs * V)
+     * @param pairs e.g. from affectedPairs
+     * @param direct direct(i, j) returns the current edge weight as a T
+     * @return Overflow if a sum is lost as in relaxRow, which a later vertex may have shortened enough to fit
+     */
+    template<typename T, typename Hop, typename Direct>
+    Status recomputePairs(DistanceMatrix<T> &dist, DistanceMatrix<Hop> *next,
+                          const std::vector<std::pair<unsigned, unsigned>> &pairs, Direct direct) {
+        constexpr T INF = DistanceMatrix<T>::INF, MIN = std::numeric_limits<T>::min();
+        std::vector<T> current(pairs.size());
+        for (size_t p = 0; p < pairs.size(); p++) {
+            unsigned i = pairs[p].first, j = pairs[p].second;
+            current[p] = dist(i, j) = direct(i, j);
+            if (next) (*next)(i, j) = i == j ? (Hop) i : current[p] == INF ? DistanceMatrix<Hop>::INF : (Hop) j;
+        }
+        bool lost = false;
+        for (size_t k = 0; k < dist.size(); k++) {
+            const T *rowK = dist.row(k);
+            for (size_t p = 0; p < pairs.size(); p++) {
+                unsigned i = pairs[p].first, j = pairs[p].second;
+                T toK = dist(i, k), fromK = rowK[j];
+                long long candidate = (long long) toK + fromK;
+                // bitwise on bools, so that the only branch is the rarely taken improvement
+                bool usable = (toK != INF) & (fromK != INF);
+                bool fits = (candidate < INF) & (candidate >= MIN);
+                // as in relaxRow, a sum that does not fit is lost below MIN, or at INF towards an entry still INF
+                lost |= usable & ((candidate < MIN) | ((candidate >= INF) & (current[p] == INF)));
+                if (usable & fits & (candidate < current[p])) {
+                    current[p] = dist(i, j) = (T) candidate;
+                    if (next) (*next)(i, j) = (*next)(i, k);
+                }
+            }
+        }
+        return lost ? Status::Overflow : Status::Done;
+    }
+}
+
+#endif //VE281P4_FLOYD_WARSHALL_HPP
@@ -0,0 +1,231 @@
+#ifndef VE281P4_LANDMARK_P2P_HPP
+#define VE281P4_LANDMARK_P2P_HPP
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "csrGraph.hpp"
+#include "radixHeap.hpp"
+#include "sparseP2P.hpp"
+
+/**
+ * Point-to-point queries by bidirectional ALT (A*, landmarks and the triangle inequality)
+ * All searches run on the Johnson-reduced weights of a SparseP2P, which are non-negative
+ * Preprocessing stores the distances from and to a few landmarks chosen far apart; by the triangle inequality
+ *   d(v, t) >= d(v, L) - d(t, L) and d(v, t) >= d(L, t) - d(L, v),
+ * which gives a lower bound pt(v) on the distance to the target, and likewise ps(v) from the source
+ * Both searches use the average potential p(v) = (pt(v) - ps(v)) / 2 (doubled to stay integral),
+ * so their keys never decrease and the search can stop once topForward + topReverse >= 2 * best path
+ * Memory: 2 * landmarks distances per vertex and the reversed graph, no V x V storage
+ * The time complexity of functions are based on V, E and the number of landmarks L
+ */
+class LandmarkP2P {
+public:
+    static constexpr long long UNREACHABLE = SparseP2P::UNREACHABLE;
+
+private:
+    static constexpr uint64_t UNREACHED = UINT64_MAX;
+    // landmark distances are stored as min(d, CAP), which is still consistent and still gives valid bounds;
+    // a vertex that can not reach a landmark the target reaches gets a bound near CAP and is never expanded
+    static constexpr uint64_t CAP = (uint64_t) 1 << 61;
+
+    struct Search {
+        std::vector<uint64_t> dist;     // reduced distance from the source of this direction
+        std::vector<char> settled;
+        RadixHeap<unsigned> heap;
+    };
+
+    const CSRGraph<int> *graph = nullptr;
+    const std::vector<long long> *potential = nullptr;
+    CSRGraph<int> reverse;
+    size_t count = 0;                       // number of landmarks
+    std::vector<unsigned> landmarks;
+    std::vector<uint64_t> fromLandmark;     // [v * count + l] = min(d(landmark l, v), CAP)
+    std::vector<uint64_t> toLandmark;       // [v * count + l] = min(d(v, landmark l), CAP)
+
+    // per query state, reset through touched
+    Search forward, backward;
+    std::vector<long long> averagePotential;
+    std::vector<char> known;
+    std::vector<unsigned> touched;
+    unsigned source = 0, target = 0;
+
+    /**
+     * Reduced weight of edge e leaving x towards y in the given direction
+     */
+    uint64_t reducedWeight(bool reversed, size_t e, unsigned x, unsigned y) const {
+        long long w = reversed ? reverse.weight(e) + (*potential)[y] - (*potential)[x]
+                               : graph->weight(e) + (*potential)[x] - (*potential)[y];
+        return (uint64_t) w;
+    }
+
+    /**
+     * Full Dijkstra search, forward from a landmark or backward to it
+     * Time Complexity: O(E + V log C)
+     */
+    void shortestFrom(unsigned root, bool reversed, std::vector<uint64_t> &dist) const {
+        const CSRGraph<int> &g = reversed ? reverse : *graph;
+        dist.assign(g.vertexCount(), UNREACHED);
+        RadixHeap<unsigned> heap;
+        dist[root] = 0;
+        heap.push(0, root);
+        while (!heap.empty()) {
+            auto item = heap.pop();
+            unsigned u = item.second;
+            if (item.first != dist[u]) continue;
+            for (size_t e = g.begin(u); e < g.end(u); e++) {
+                unsigned v = g.target(e);
+                uint64_t candidate = item.first + reducedWeight(reversed, e, u, v);
+                if (candidate < dist[v]) {
+                    dist[v] = candidate;
+                    heap.push(candidate, v);
+                }
+            }
+        }
+    }
+
+    /**
+     * Choose landmarks greedily by the farthest heuristic: each new landmark maximizes the round trip distance
+     * to the closest landmark chosen so far, vertices that can not reach some landmark first
+     * Time Complexity: O(L (E + V log C) + LV)
+     */
+    void chooseLandmarks() {
+        size_t V = graph->vertexCount();
+        std::vector<uint64_t> from, to, closest(V, UNREACHED);
+        // the first landmark is the vertex farthest from vertex 0
+        shortestFrom(0, false, from);
+        unsigned next = 0;
+        for (size_t v = 0; v < V; v++) {
+            if (from[v] != UNREACHED && from[v] > from[next]) next = (unsigned) v;
+        }
+        fromLandmark.assign(V * count, CAP);
+        toLandmark.assign(V * count, CAP);
+        for (size_t l = 0; l < count; l++) {
+            landmarks.push_back(next);
+            shortestFrom(next, false, from);
+            shortestFrom(next, true, to);
+            for (size_t v = 0; v < V; v++) {
+                fromLandmark[v * count + l] = std::min(from[v], CAP);
+                toLandmark[v * count + l] = std::min(to[v], CAP);
+                closest[v] = std::min(closest[v], std::min(from[v], CAP) + std::min(to[v], CAP));
+            }
+            for (size_t v = 0; v < V; v++) {
+                if (closest[v] > closest[next]) next = (unsigned) v;
+            }
+        }
+    }
+
+    /**
+     * @return 2p(v) = pt(v) - ps(v) for the current query, computed once per vertex
+     * Time Complexity: O(L)
+     */
+    long long potentialOf(unsigned v) {
+        if (known[v]) return averagePotential[v];
+        const uint64_t *fromV = &fromLandmark[v * count], *toV = &toLandmark[v * count];
+        const uint64_t *fromS = &fromLandmark[source * count], *toS = &toLandmark[source * count];
+        const uint64_t *fromT = &fromLandmark[target * count], *toT = &toLandmark[target * count];
+        long long toTarget = 0, fromSource = 0;
+        for (size_t l = 0; l < count; l++) {
+            toTarget = std::max(toTarget, std::max((long long) toV[l] - (long long) toT[l],
+                                                   (long long) fromT[l] - (long long) fromV[l]));
+            fromSource = std::max(fromSource, std::max((long long) toS[l] - (long long) toV[l],
+                                                       (long long) fromV[l] - (long long) fromS[l]));
+        }
+        known[v] = 1;
+        touched.push_back(v);
+        return averagePotential[v] = toTarget - fromSource;
+    }
+
+    void resetQuery() {
+        for (unsigned v : touched) {
+            forward.dist[v] = backward.dist[v] = UNREACHED;
+            forward.settled[v] = backward.settled[v] = 0;
+            known[v] = 0;
+        }
+        touched.clear();
+        forward.heap.clear();
+        backward.heap.clear();
+    }
+
+    /**
+     * Settle the top vertex of one direction and relax its edges, updating the best path found so far
+     */
+    void step(bool reversed, uint64_t &best) {
+        Search &search = reversed ? backward : forward;
+        const Search &other = reversed ? forward : backward;
+        const CSRGraph<int> &g = reversed ? reverse : *graph;
+        unsigned u = search.heap.pop().second;
+        if (search.settled[u]) return;
+        search.settled[u] = 1;
+        for (size_t e = g.begin(u); e < g.end(u); e++) {
+            unsigned v = g.target(e);
+            uint64_t candidate = search.dist[u] + reducedWeight(reversed, e, u, v);
+            if (candidate >= search.dist[v]) continue;
+            long long p = potentialOf(v);
+            search.dist[v] = candidate;
+            search.heap.push(2 * candidate + (uint64_t) (reversed ? -p : p), v);
+            if (other.dist[v] != UNREACHED) best = std::min(best, candidate + other.dist[v]);
+        }
+    }
+
+public:
+    /**
+     * Preprocess the graph of a SparseP2P, which must outlive this object and not be rebuilt
+     * Time Complexity: O(L (E + V log C) + LV)
+     * @param sparse a built SparseP2P without negative cycles
+     * @param landmarkCount number of landmarks, at most V
+     */
+    void build(const SparseP2P &sparse, size_t landmarkCount) {
+        graph = &sparse.getGraph();
+        potential = &sparse.getPotential();
+        reverse = graph->reversed();
+        size_t V = graph->vertexCount();
+        count = std::min(std::max<size_t>(landmarkCount, 1), V);
+        landmarks.clear();
+        if (V > 0) chooseLandmarks();
+        forward.dist.assign(V, UNREACHED);
+        backward.dist.assign(V, UNREACHED);
+        forward.settled.assign(V, 0);
+        backward.settled.assign(V, 0);
+        averagePotential.assign(V, 0);
+        known.assign(V, 0);
+        touched.clear();
+    }
+
+    /**
+     * Time Complexity: O(E + V (L + log C)) worst case, usually a small part of the graph around the shortest path
+     * @return the shortest distance from A to B, or UNREACHABLE if B can not be reached from A
+     */
+    long long distance(unsigned A, unsigned B) {
+        if (A == B) return 0;
+        resetQuery();
+        source = A;
+        target = B;
+        forward.dist[A] = 0;
+        backward.dist[B] = 0;
+        forward.heap.push((uint64_t) potentialOf(A), A);
+        backward.heap.push((uint64_t) -potentialOf(B), B);
+        uint64_t best = UNREACHED;
+        while (!forward.heap.empty() && !backward.heap.empty()) {
+            uint64_t topForward = forward.heap.topKey(), topReverse = backward.heap.topKey();
+            if (best != UNREACHED && topForward + topReverse >= 2 * best) break;
+            step(topReverse < topForward, best);
+        }
+        if (best == UNREACHED) return UNREACHABLE;
+        return (long long) best - (*potential)[A] + (*potential)[B];
+    }
+
+    const std::vector<unsigned> &getLandmarks() const { return landmarks; }
+
+    /**
+     * @return bytes of the landmark distances and the reversed graph
+     */
+    size_t memoryBytes() const {
+        return (fromLandmark.capacity() + toLandmark.capacity()) * sizeof(uint64_t) + reverse.memoryBytes();
+    }
+};
+
+#endif //VE281P4_LANDMARK_P2P_HPP
@@ -1,18 +1,110 @@
 #include "shortestP2P.hpp"
 
-using namespace std;
+#include <map>
+#include <set>
+#include <string>
 
-int main () {
-	ShortestP2P a;
-	a.readGraph();
+using namespace std;
 
-	int A, B;
+// Usage: ./main [-t threads] [-e dense|sparse|landmarks|hierarchy] [-l landmarks] [-i index] [-b binary]
+//               [-w 16|32|64] [-p] [-m megabytes] [-r] [-n] [-v] < input
+// -t sets the threads of the all-pairs computation, 0 for one per hardware thread (default 1)
+// -e selects the all-pairs matrix (default), per-query Dijkstra on the sparse graph, bidirectional ALT,
+//    or contraction hierarchies
+// -l sets the number of landmarks of ALT (default 16)
+// -i names the contraction hierarchy index file, reused while the graph does not change
+// -b converts the graph on the input to the binary edge list format of fastIO.hpp and exits;
+//    a binary graph is recognized on the input, and may be followed by queries in text
+// -w sets the width of the all-pairs distances (default 32), 16 halves the memory if all distances fit
+// -p keeps next hops and prints each shortest path after its distance, as "distance: A ... B"
+// -m refuses graphs whose all-pairs matrices would take more than the given megabytes
+// -r prints the memory of the all-pairs matrices at every width to stderr before allocating them
+// -n looks for a negative cycle in O(VE) before the O(V^3) all-pairs computation
+// -v reports the progress of the all-pairs computation and the vertices of a negative cycle on stderr
+int main (int argc, char **argv) {
+	ShortestP2P::Options options;
+	string binaryPath;
+	bool verbose = false;
+	const map<string, ShortestP2P::Engine> engines = {
+		{"dense", ShortestP2P::Engine::Dense},
+		{"sparse", ShortestP2P::Engine::Sparse},
+		{"landmarks", ShortestP2P::Engine::Landmarks},
+		{"hierarchy", ShortestP2P::Engine::Hierarchy}
+	};
+	const set<string> widths = {"16", "32", "64"};
+	for (int i = 1; i < argc; i++) {
+		string flag = argv[i];
+		if ((flag == "-t" || flag == "--threads") && i + 1 < argc) {
+			options.threads = (unsigned) stoul(argv[++i]);
+		} else if ((flag == "-e" || flag == "--engine") && i + 1 < argc && engines.count(argv[i + 1])) {
+			options.engine = engines.at(argv[++i]);
+		} else if ((flag == "-l" || flag == "--landmarks") && i + 1 < argc) {
+			options.landmarks = (unsigned) stoul(argv[++i]);
+		} else if ((flag == "-i" || flag == "--index") && i + 1 < argc) {
+			options.indexPath = argv[++i];
+		} else if ((flag == "-b" || flag == "--write-binary") && i + 1 < argc) {
+			binaryPath = argv[++i];
+		} else if ((flag == "-w" || flag == "--width") && i + 1 < argc && widths.count(argv[i + 1])) {
+			options.distanceBits = (unsigned) stoul(argv[++i]);
+		} else if (flag == "-p" || flag == "--paths") {
+			options.paths = true;
+		} else if ((flag == "-m" || flag == "--memory-limit") && i + 1 < argc) {
+			options.memoryLimit = (size_t) stoull(argv[++i]) << 20;
+		} else if (flag == "-r" || flag == "--report-memory") {
+			options.reportMemory = true;
+		} else if (flag == "-n" || flag == "--prepass") {
+			options.prepass = true;
+		} else if (flag == "-v" || flag == "--verbose") {
+			verbose = true;
+		} else {
+			cerr << "Usage: " << argv[0] << " [-t threads] [-e dense|sparse|landmarks|hierarchy] [-l landmarks] [-i index] [-b binary]"
+			     << " [-w 16|32|64] [-p] [-m megabytes] [-r] [-n] [-v]" << endl;
+			return 1;
+		}
+	}
+	if (!binaryPath.empty()) {
+		FastIO::Reader &in = FastIO::input();
+		uint64_t V = 0, E = 0;
+		bool binary;
+		FastIO::readGraphHeader(in, V, E, binary);
+		vector<Edge> edges;
+		edges.reserve(E);
+		FastIO::readEdges(in, E, binary, [&](unsigned from, unsigned to, int weight) {
+			edges.push_back({from, to, weight});
+		});
+		FastIO::writeBinaryGraph(binaryPath, V, edges);
+		return 0;
+	}
+	if (verbose) {
+		options.progress = [](size_t done, size_t rounds) {
+			cerr << "\rFloyd–Warshall: " << done * 100 / rounds << "%" << (done == rounds ? "\n" : "") << flush;
+			return true;
+		};
+	}
+	try {
+		ShortestP2P a(options);
+		a.readGraph();
 
-	cin >> A;
-	do {
-		cin >> B;
-		a.distance(A, B);
-		cin >> A;
-	} while (A >= 0);
+		// queries follow the graph on the same input, answers are flushed once at exit
+		FastIO::Reader &in = FastIO::input();
+		long long A, B;
+		while (in.read(A) && A >= 0 && in.read(B)) {
+			a.distance((unsigned) A, (unsigned) B);
+		}
+	} catch (const ShortestP2P::NegativeCycleError &error) {
+		FastIO::output().write("Invalid graph. Exiting.\n");
+		FastIO::output().flush();
+		if (verbose && !error.getCycle().empty()) {
+			cerr << "negative cycle:";
+			for (unsigned v : error.getCycle()) cerr << " " << v;
+			cerr << " " << error.getCycle()[0] << endl;
+		}
+		return 0;
+	} catch (const exception &error) {
+		FastIO::output().flush();
+		cerr << error.what() << ". Exiting." << endl;
+		return 1;
+	}
+	FastIO::output().flush();
 	return 0;
 }
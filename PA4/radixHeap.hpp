@@ -0,0 +1,93 @@
+#ifndef VE281P4_RADIX_HEAP_HPP
+#define VE281P4_RADIX_HEAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * A monotone priority queue of unsigned 64-bit keys, as used by Dijkstra with non-negative weights
+ * Bucket b holds the keys whose highest bit differing from the last popped key is bit b - 1,
+ * bucket 0 the keys equal to it; a pushed key must not be smaller than the last popped key
+ * Each item moves to a lower bucket at most 64 times, so push and pop cost O(1) amortized
+ * without any comparison between items, and the buckets are plain vectors
+ * @tparam Value
+ */
+template<typename Value>
+class RadixHeap {
+public:
+    typedef std::pair<uint64_t, Value> Item;
+
+private:
+    static constexpr size_t BUCKETS = 65;
+
+    std::vector<Item> buckets[BUCKETS];
+    uint64_t last = 0;
+    size_t count = 0;
+
+    static size_t bucketOf(uint64_t key, uint64_t last) {
+        return key == last ? 0 : 64 - (size_t) __builtin_clzll(key ^ last);
+    }
+
+    /**
+     * Move the items of the first non-empty bucket down, relative to their minimum key
+     * Time Complexity: O(size of the bucket)
+     */
+    void refill() {
+        size_t b = 1;
+        while (buckets[b].empty()) b++;
+        uint64_t minKey = buckets[b][0].first;
+        for (auto &item : buckets[b]) minKey = item.first < minKey ? item.first : minKey;
+        last = minKey;
+        for (auto &item : buckets[b]) buckets[bucketOf(item.first, last)].push_back(std::move(item));
+        buckets[b].clear();
+    }
+
+public:
+    bool empty() const { return count == 0; }
+
+    size_t size() const { return count; }
+
+    /**
+     * Time Complexity: O(1)
+     * @param key not smaller than the last popped key
+     * @param value
+     */
+    void push(uint64_t key, const Value &value) {
+        buckets[bucketOf(key, last)].emplace_back(key, value);
+        count++;
+    }
+
+    /**
+     * @return the smallest key, the heap must not be empty
+     * Time Complexity: O(1) amortized
+     */
+    uint64_t topKey() {
+        if (buckets[0].empty()) refill();
+        return last;
+    }
+
+    /**
+     * Remove an item with the smallest key, the heap must not be empty
+     * Time Complexity: O(1) amortized
+     */
+    Item pop() {
+        if (buckets[0].empty()) refill();
+        Item item = std::move(buckets[0].back());
+        buckets[0].pop_back();
+        count--;
+        return item;
+    }
+
+    /**
+     * Remove all items, keeping the memory of the buckets
+     */
+    void clear() {
+        for (auto &bucket : buckets) bucket.clear();
+        last = 0;
+        count = 0;
+    }
+};
+
+#endif //VE281P4_RADIX_HEAP_HPP
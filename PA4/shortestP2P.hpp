@@ -2,6 +2,19 @@
 #include<list>
 #include<vector>
 #include<climits>
+#include<cstdint>
+#include<functional>
+#include<stdexcept>
+#include<string>
+#include<tuple>
+#include<unordered_map>
+#include "bellmanFord.hpp"
+#include "contractionHierarchy.hpp"
+#include "distanceMatrix.hpp"
+#include "fastIO.hpp"
+#include "floydWarshall.hpp"
+#include "landmarkP2P.hpp"
+#include "sparseP2P.hpp"
 // You are not allowed to include additional libraries
 
 #define INF INT_MAX
@@ -11,8 +24,76 @@ using namespace std;
 
 class ShortestP2P {
   public:
+      enum class Engine {
+        Dense,      // all-pairs matrix by Floyd–Warshall, O(V^2) memory and O(1) queries
+        Sparse,     // CSR graph with Johnson potentials, O(V + E) memory and one Dijkstra search per query
+        Landmarks,  // Sparse plus distances to a few landmarks, one bidirectional ALT search per query
+        Hierarchy   // Sparse plus contraction hierarchies, one bidirectional upward search per query
+      };
+
+      static constexpr long long UNREACHABLE = SparseP2P::UNREACHABLE;
+
+      struct Options {
+        unsigned threads = 1;   // threads of the all-pairs computation, 0 for one per hardware thread
+        Engine engine = Engine::Dense;
+        unsigned landmarks = 16;  // landmarks of Engine::Landmarks, 2 * 8 bytes per vertex each
+        // index file of Engine::Hierarchy: loaded if it was built for the same graph, otherwise built and saved
+        string indexPath;
+        unsigned distanceBits = 32;   // width of the distances of Engine::Dense: 16, 32 or 64
+        bool paths = false;     // keep the next hop of every shortest path of Engine::Dense, for path()
+        // bytes the matrices of Engine::Dense may take, 0 for no limit; when a 16 or 32-bit run loses a sum,
+        // a copy of the edge matrix and one of the next wider width are also held while it is run again
+        size_t memoryLimit = 0;
+        bool reportMemory = false;  // print the memory of the matrices to stderr before allocating them
+        bool updates = false;   // keep the edges of Engine::Dense for updateEdge(), in a hash map
+        // look for a negative cycle with SPFA in O(VE) before the O(V^3) run of Engine::Dense,
+        // on a copy of the edges that is freed before the run
+        bool prepass = false;
+        // called with (rounds done, rounds) during Floyd–Warshall, V / 64 rounds; returning false cancels it
+        FloydWarshall::Progress progress;
+      };
+
+      /**
+       * Thrown by readGraph when some pair of vertices has no minimum distance
+       */
+      class NegativeCycleError : public runtime_error {
+        vector<unsigned> cycle;
+
+      public:
+        explicit NegativeCycleError(vector<unsigned> cycle)
+            : runtime_error("the graph has a negative cycle"), cycle(std::move(cycle)) {}
+
+        /**
+         * @return v0, v1, ..., with edges v0 -> v1 -> ... -> v0 of negative total weight;
+         * empty if Engine::Dense found it without Options::prepass or Options::updates, which keep the edges
+         */
+        const vector<unsigned> &getCycle() const { return cycle; }
+      };
+
+      /**
+       * Thrown by readGraph when Options::progress cancels the computation
+       */
+      class CancelledError : public runtime_error {
+      public:
+        CancelledError() : runtime_error("cancelled") {}
+      };
+
+      /**
+       * Memory of the matrices of Engine::Dense, known before anything is allocated
+       * The next hops are 16-bit vertices while the padded V fits, and 32-bit beyond that
+       * Time Complexity: O(1)
+       * @return bytes of the distances, plus the next hops if paths is set
+       */
+      static size_t denseBytes(size_t V, unsigned distanceBits, bool paths) {
+        size_t entries = DistanceMatrix<char>::bytes(V, FloydWarshall::TILE);
+        size_t hopBytes = paddedSize(V) <= UINT16_MAX ? 2 : 4;
+        return entries * (distanceBits / 8) + (paths ? entries * hopBytes : 0);
+      }
+
       ShortestP2P() {}
 
+      explicit ShortestP2P(const Options &options) : options(options) {}
+
       /* Read the graph from stdin
        * The input has the following format:
        *
@@ -37,21 +118,46 @@ class ShortestP2P {
        * cout << "Invalid graph. Exiting." << endl;
        *
        * Note: vertex pairs that are not connected, which have infinitely large distances are not considered cases where "minimum distances do not exist".
+       *
+       * Nothing is printed and the process is not terminated here: that case throws NegativeCycleError,
+       * and main prints the message. Distances that do not fit in Options::distanceBits throw overflow_error,
+       * a graph over Options::memoryLimit throws length_error, a truncated input throws runtime_error,
+       * and a cancelled computation throws CancelledError; the object has no usable distances after any of them.
        */
       void readGraph(){
-        std::cin >> V >> E;
-        dist = vector<vector<int>>(V, vector<int>(V, INF));
-        for(int i=0; i<V; i++){
-          dist[i][i] = 0;
+        readGraph(FastIO::input());
+      }
+
+      /* Input: a reader of the graph in the format of readGraph() above, e.g. of a file
+       */
+      void readGraph(FastIO::Reader &in){
+        // text as above, or the binary edge list of fastIO.hpp, parsed in bulk
+        bool binary;
+        if (!FastIO::readGraphHeader(in, V, E, binary)) {
+          throw runtime_error("the input ends before the number of vertices and edges");
         }
 
-        for(int i=0; i<E; i++){
-          int src, dest, weight;
-          cin >> src >> dest >> weight;
-          dist[src][dest] = weight;
+        if (options.engine != Engine::Dense) {
+          vector<Edge> edges;
+          edges.reserve(E);
+          FastIO::readEdges(in, E, binary, [&](unsigned from, unsigned to, int weight) {
+            edges.push_back({from, to, weight});
+          });
+          if (!sparse.build(V, edges)) throw NegativeCycleError(sparse.getNegativeCycle());
+          vector<Edge>().swap(edges);
+          if (options.engine == Engine::Landmarks) landmarks.build(sparse, options.landmarks);
+          if (options.engine == Engine::Hierarchy) buildHierarchy();
+          return;
         }
 
-        floydWarshall();
+        if (options.reportMemory) reportMemory();
+        size_t bytes = denseBytes(V, options.distanceBits, options.paths);
+        if (options.memoryLimit && bytes > options.memoryLimit) exceedsMemoryLimit(bytes);
+        switch (options.distanceBits) {
+          case 16: readDense<int16_t>(in, binary); break;
+          case 64: readDense<int64_t>(in, binary); break;
+          default: readDense<int32_t>(in, binary);
+        }
       }
 
       /* Input: 2 vertices A and B
@@ -63,31 +169,321 @@ class ShortestP2P {
        */
       // Floyd's algorithm, works great for small graphs
       void distance(unsigned int A, unsigned int B){
-        if(dist[A][B] == INF)
-          cout << "INF" << endl;
-        else cout << dist[A][B] << endl;
+        long long d = query(A, B);
+        printDistance(d, d == UNREACHABLE, A, B);
+      }
+
+      /* Input: 2 vertices A and B
+       * Output: the distance between them that distance() prints, or UNREACHABLE when they are not connected
+       */
+      long long query(unsigned A, unsigned B) {
+        if (options.engine != Engine::Dense) {
+          return options.engine == Engine::Sparse ? sparse.distance(A, B)
+               : options.engine == Engine::Landmarks ? landmarks.distance(A, B) : hierarchy.distance(A, B);
+        }
+        switch (options.distanceBits) {
+          case 16: return denseDistance<int16_t>(A, B);
+          case 64: return denseDistance<int64_t>(A, B);
+          default: return denseDistance<int32_t>(A, B);
+        }
+      }
+
+      /* Input: 2 vertices A and B
+       * Output: the vertices of a shortest path from A to B, starting with A and ending with B,
+       * or nothing when they are not connected
+       * Only kept by Engine::Dense with Options::paths
+       */
+      vector<unsigned> path(unsigned A, unsigned B) const {
+        if (options.engine != Engine::Dense || !options.paths) {
+          throw logic_error("paths are only kept by the dense engine with Options::paths");
+        }
+        switch (options.distanceBits) {
+          case 16: return densePath<int16_t>(A, B);
+          case 64: return densePath<int64_t>(A, B);
+          default: return densePath<int32_t>(A, B);
+        }
+      }
+
+      /* Input: an edge A -> B and its new weight, or a new edge
+       * Repairs the distances instead of recomputing them: O(V^2) when the weight decreases or the edge is new,
+       * and when it increases, a recomputation of only the pairs whose shortest paths may use the edge
+       * (all pairs, with the full blocked Floyd–Warshall, if that is more than 1 / REPAIR_FRACTION of them)
+       * Only Engine::Dense with Options::updates keeps the edges this needs
+       * Output: false, with the graph unchanged, if the edge would close a negative cycle
+       * Throws overflow_error if some distance would not fit in Options::distanceBits, or CancelledError
+       * if Options::progress cancels a full recomputation, also with the graph unchanged
+       */
+      bool updateEdge(unsigned A, unsigned B, int weight) {
+        if (options.engine != Engine::Dense || !options.updates) {
+          throw logic_error("edges are only kept by the dense engine with Options::updates");
+        }
+        switch (options.distanceBits) {
+          case 16: return updateDense<int16_t>(A, B, weight);
+          case 64: return updateDense<int64_t>(A, B, weight);
+          default: return updateDense<int32_t>(A, B, weight);
+        }
       }
 
   private:
     // internal data and functions.
-    int V, E;
-    vector<vector<int>> dist;
-
-    void floydWarshall() {
-      for(int k=0; k<V; k++){
-        for(int i=0; i<V; i++){
-          for(int j=0; j<V; j++){
-            if(dist[i][k] != INF && dist[k][j] != INF && dist[i][k]+dist[k][j] < dist[i][j]) {
-              dist[i][j] = dist[i][k] + dist[k][j];
-            }
-          }
+    // an increase recomputes the affected pairs one by one while they are at most V^2 / REPAIR_FRACTION;
+    // per entry and vertex that is about 20 times slower than the blocked and vectorized Floyd–Warshall
+    static constexpr size_t REPAIR_FRACTION = 32;
+
+    uint64_t V = 0, E = 0;
+    Options options;
+    // contiguous, padded to whole tiles of FloydWarshall::TILE; only the width of options.distanceBits is used
+    tuple<DistanceMatrix<int16_t>, DistanceMatrix<int32_t>, DistanceMatrix<int64_t>> dist;
+    // next hops with options.paths, 16-bit while the padded V fits
+    tuple<DistanceMatrix<uint16_t>, DistanceMatrix<uint32_t>> next;
+    unordered_map<uint64_t, int> edgeWeights;   // (from << 32 | to) -> weight with options.updates
+    SparseP2P sparse;           // used instead of dist by the other engines
+    LandmarkP2P landmarks;      // preprocessing of sparse for Engine::Landmarks
+    ContractionHierarchy hierarchy;   // preprocessing of sparse for Engine::Hierarchy
+
+    static size_t paddedSize(size_t V) {
+      return (V + FloydWarshall::TILE - 1) / FloydWarshall::TILE * FloydWarshall::TILE;
+    }
+
+    // buffered, one line per query without flushing; with options.paths the path follows the distance
+    void printDistance(long long d, bool unreachable, unsigned A, unsigned B) {
+      FastIO::Writer &out = FastIO::output();
+      if (unreachable) {
+        out.write("INF\n", 4);
+        return;
+      }
+      out.write(d);
+      if (options.engine == Engine::Dense && options.paths) {
+        out.put(':');
+        for (unsigned v : path(A, B)) {
+          out.put(' ');
+          out.write((long long) v);
+        }
+      }
+      out.put('\n');
+    }
+
+    template<typename T>
+    long long denseDistance(unsigned A, unsigned B) const {
+      const DistanceMatrix<T> &d = get<DistanceMatrix<T>>(dist);
+      return d(A, B) == numeric_limits<T>::max() ? UNREACHABLE : (long long) d(A, B);
+    }
+
+    template<typename T>
+    vector<unsigned> densePath(unsigned A, unsigned B) const {
+      const DistanceMatrix<T> &d = get<DistanceMatrix<T>>(dist);
+      if (d.paddedSize() <= UINT16_MAX) return FloydWarshall::path(d, get<0>(next), A, B);
+      return FloydWarshall::path(d, get<1>(next), A, B);
+    }
+
+    /**
+     * Call visit(matrix of width T, next hops or nullptr), with the next hops of the width in use
+     */
+    template<typename T, typename Visitor>
+    void withDense(Visitor visit) {
+      DistanceMatrix<T> &d = get<DistanceMatrix<T>>(dist);
+      if (!options.paths) visit(d, (DistanceMatrix<uint16_t> *) nullptr);
+      else if (d.paddedSize() <= UINT16_MAX) visit(d, &get<0>(next));
+      else visit(d, &get<1>(next));
+    }
+
+    template<typename T>
+    static bool fits(long long weight) {
+      // the largest T means no edge, as INF always did with int
+      return weight >= numeric_limits<T>::min() && weight <= numeric_limits<T>::max();
+    }
+
+    // the matrix entry of an edge: a non-negative self-loop never beats the empty path
+    template<typename T>
+    static T entry(unsigned from, unsigned to, int weight) {
+      return from == to && weight > 0 ? 0 : (T) weight;
+    }
+
+    static uint64_t edgeKey(unsigned from, unsigned to) {
+      return (uint64_t) from << 32 | to;
+    }
+
+    /**
+     * Fill the matrix of width T straight from the input, without an edge list unless options.prepass is set,
+     * and run Floyd–Warshall
+     * Time Complexity: O(V^3), O(VE) with options.prepass if there is a negative cycle
+     */
+    template<typename T>
+    void readDense(FastIO::Reader &in, bool binary) {
+      DistanceMatrix<T> &d = get<DistanceMatrix<T>>(dist);
+      d = DistanceMatrix<T>(V, FloydWarshall::TILE);
+      if (options.updates) edgeWeights.reserve(E);
+      vector<Edge> edges;
+      if (options.prepass) edges.reserve(E);
+      bool allFit = true;
+      FastIO::readEdges(in, E, binary, [&](unsigned from, unsigned to, int weight) {
+        allFit &= fits<T>(weight);
+        d(from, to) = entry<T>(from, to, weight);
+        if (options.updates) edgeWeights[edgeKey(from, to)] = weight;
+        if (options.prepass) edges.push_back({from, to, weight});
+      });
+      if (options.prepass) {
+        vector<unsigned> cycle = negativeCycle(edges);
+        if (!cycle.empty()) throw NegativeCycleError(cycle);
+      }
+      if (!allFit) overflow();
+      check(runDense<T>());
+    }
+
+    /**
+     * A negative cycle of the edges, by SPFA
+     * Time Complexity: O(VE) worst case, O(V + E) when no weight is negative
+     * @param edges freed on return
+     * @return the cycle as in NegativeCycleError, or nothing
+     */
+    vector<unsigned> negativeCycle(vector<Edge> &edges) {
+      CSRGraph<int> graph(V, edges);
+      vector<Edge>().swap(edges);
+      vector<long long> potential;
+      vector<unsigned> cycle;
+      BellmanFord::potentials(graph, potential, cycle);
+      return cycle;
+    }
+
+    /**
+     * Floyd–Warshall on the edges in the matrix of width T, with fresh next hops if options.paths is set
+     * A sum that does not fit in 16 or 32 bits is settled by a run in the next wider type,
+     * so Overflow means that some shortest distance does not fit in T
+     */
+    template<typename T>
+    FloydWarshall::Status runDense() {
+      typedef typename conditional<sizeof(T) == 2, int32_t, int64_t>::type Wide;
+      FloydWarshall::Status status = FloydWarshall::Status::Done;
+      withDense<T>([&](DistanceMatrix<T> &d, auto *hops) {
+        typedef typename remove_pointer<decltype(hops)>::type::value_type Hop;
+        if (hops) *hops = FloydWarshall::nextHops<Hop>(d);
+        status = FloydWarshall::runWidening<Wide>(d, hops, options.threads, options.progress);
+      });
+      return status;
+    }
+
+    /**
+     * The matrix of width T again from the stored edges
+     * Time Complexity: O(V^3)
+     */
+    template<typename T>
+    FloydWarshall::Status recomputeDense() {
+      DistanceMatrix<T> &d = get<DistanceMatrix<T>>(dist);
+      d = DistanceMatrix<T>(V, FloydWarshall::TILE);
+      for (auto &edge : edgeWeights) {
+        unsigned from = (unsigned) (edge.first >> 32), to = (unsigned) edge.first;
+        d(from, to) = entry<T>(from, to, edge.second);
+      }
+      return runDense<T>();
+    }
+
+    /**
+     * Every failure leaves the edges, distances and next hops as they were: decreaseEdge checks before it writes,
+     * a recomputation of some pairs saves them first, and a full recomputation works on a copy of the matrices
+     * A recomputation of some pairs that loses a sum falls back to the full one, which settles it in a wider type
+     */
+    template<typename T>
+    bool updateDense(unsigned A, unsigned B, int weight) {
+      if (!fits<T>(weight)) overflow();
+      uint64_t key = edgeKey(A, B);
+      auto found = edgeWeights.find(key);
+      bool existed = found != edgeWeights.end();
+      int previous = existed ? found->second : 0;
+      T before = existed ? entry<T>(A, B, previous) : A == B ? 0 : numeric_limits<T>::max();
+      T after = entry<T>(A, B, weight);
+      edgeWeights[key] = weight;
+      FloydWarshall::Status status = FloydWarshall::Status::Done;
+      withDense<T>([&](DistanceMatrix<T> &d, auto *hops) {
+        typedef typename remove_pointer<decltype(hops)>::type::value_type Hop;
+        if (after < before) {
+          status = FloydWarshall::decreaseEdge(d, hops, A, B, after);
+          return;
         }
-        for (int i = 0; i < V; i++) {
-          if (dist[i][i] < 0) {
-            cout << "Invalid graph. Exiting." << endl;
-            exit(0);
+        vector<pair<unsigned, unsigned>> pairs;
+        if (after == before) return;
+        if (FloydWarshall::affectedPairs(d, A, B, before, d.size() * d.size() / REPAIR_FRACTION, pairs)) {
+          vector<T> savedDist(pairs.size());
+          vector<Hop> savedHops(hops ? pairs.size() : 0);
+          for (size_t p = 0; p < pairs.size(); p++) {
+            savedDist[p] = d(pairs[p].first, pairs[p].second);
+            if (hops) savedHops[p] = (*hops)(pairs[p].first, pairs[p].second);
+          }
+          status = FloydWarshall::recomputePairs(d, hops, pairs, [&](unsigned from, unsigned to) {
+            if (from == to) return (T) 0;
+            auto edge = edgeWeights.find(edgeKey(from, to));
+            return edge == edgeWeights.end() ? numeric_limits<T>::max() : entry<T>(from, to, edge->second);
+          });
+          if (status == FloydWarshall::Status::Done) return;
+          for (size_t p = 0; p < pairs.size(); p++) {
+            d(pairs[p].first, pairs[p].second) = savedDist[p];
+            if (hops) (*hops)(pairs[p].first, pairs[p].second) = savedHops[p];
           }
         }
+        DistanceMatrix<T> savedDist = d;
+        DistanceMatrix<Hop> savedHops;
+        if (hops) savedHops = *hops;
+        status = recomputeDense<T>();
+        if (status == FloydWarshall::Status::Done) return;
+        d.swap(savedDist);
+        if (hops) hops->swap(savedHops);
+      });
+      if (status == FloydWarshall::Status::Done) return true;
+      if (existed) edgeWeights[key] = previous;
+      else edgeWeights.erase(key);
+      if (status == FloydWarshall::Status::NegativeCycle) return false;
+      check(status);
+      return true;
+    }
+
+    void reportMemory() {
+      auto megabytes = [](size_t bytes) { return to_string((bytes + (1 << 20) - 1) >> 20) + " MB"; };
+      cerr << "Dense engine, V = " << V << " padded to " << paddedSize(V) << ":" << endl;
+      for (unsigned bits : {16, 32, 64}) {
+        cerr << "  " << bits << "-bit distances: " << megabytes(denseBytes(V, bits, false)) << endl;
+      }
+      cerr << "  next hops for paths: " << megabytes(denseBytes(V, 0, true)) << endl;
+      cerr << "  selected: " << megabytes(denseBytes(V, options.distanceBits, options.paths)) << endl;
+    }
+
+    // the negative cycle found by Floyd–Warshall, traced again on the stored edges if there are any
+    void invalidGraph() {
+      vector<Edge> edges;
+      edges.reserve(edgeWeights.size());
+      for (auto &edge : edgeWeights) {
+        edges.push_back({(unsigned) (edge.first >> 32), (unsigned) edge.first, edge.second});
+      }
+      throw NegativeCycleError(negativeCycle(edges));
+    }
+
+    void overflow() {
+      throw overflow_error("Distances do not fit in " + to_string(options.distanceBits) + " bits");
+    }
+
+    void exceedsMemoryLimit(size_t bytes) {
+      throw length_error("The dense engine needs " + to_string(bytes) + " bytes, more than the limit of " +
+                         to_string(options.memoryLimit));
+    }
+
+    void buildHierarchy() {
+      if (!options.indexPath.empty()) {
+        try {
+          hierarchy.load(options.indexPath, sparse);
+          return;
+        } catch (const runtime_error &) {
+          // missing, stale or damaged, build it again
+        }
+      }
+      hierarchy.build(sparse);
+      if (!options.indexPath.empty()) hierarchy.save(options.indexPath);
+    }
+
+    // the exception of a failed Floyd–Warshall run (blocked and vectorized, see floydWarshall.hpp)
+    void check(FloydWarshall::Status status) {
+      switch (status) {
+        case FloydWarshall::Status::NegativeCycle: invalidGraph(); break;
+        case FloydWarshall::Status::Overflow: overflow(); break;
+        case FloydWarshall::Status::Cancelled: throw CancelledError();
+        case FloydWarshall::Status::Done: break;
       }
     }
 };
\ No newline at end of file
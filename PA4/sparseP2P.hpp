@@ -0,0 +1,131 @@
+#ifndef VE281P4_SPARSE_P2P_HPP
+#define VE281P4_SPARSE_P2P_HPP
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bellmanFord.hpp"
+#include "csrGraph.hpp"
+#include "radixHeap.hpp"
+
+/**
+ * Point-to-point shortest distances on a large sparse graph, without any V x V storage
+ * Negative weights are handled with Johnson's reweighting: SPFA from a virtual source (bellmanFord.hpp)
+ * computes potentials h once, and the reduced weights w(u, v) + h(u) - h(v) are non-negative, so each query
+ * is a Dijkstra search on a radix heap that stops as soon as the target is settled
+ * Consecutive queries from the same source resume the previous search instead of starting over
+ * The time complexity of functions are based on V and E
+ */
+class SparseP2P {
+public:
+    static constexpr long long UNREACHABLE = LLONG_MAX;
+
+private:
+    static constexpr uint64_t UNREACHED = UINT64_MAX;
+    static constexpr unsigned NO_SOURCE = UINT_MAX;
+
+    CSRGraph<int> graph;
+    std::vector<long long> potential;
+    std::vector<unsigned> negativeCycle;
+
+    // state of the search from source, reset through touched
+    unsigned source = NO_SOURCE;
+    std::vector<uint64_t> reducedDist;
+    std::vector<char> settled;
+    std::vector<unsigned> touched;
+    RadixHeap<unsigned> heap;
+
+    void resetSearch() {
+        for (unsigned v : touched) {
+            reducedDist[v] = UNREACHED;
+            settled[v] = 0;
+        }
+        touched.clear();
+        heap.clear();
+        source = NO_SOURCE;
+    }
+
+    /**
+     * Continue the search from source until target is settled or nothing is left to settle
+     * Time Complexity: O(E + V log C) worst case
+     */
+    void searchUntil(unsigned target) {
+        while (!settled[target] && !heap.empty()) {
+            auto item = heap.pop();
+            unsigned u = item.second;
+            if (settled[u] || item.first != reducedDist[u]) continue;
+            settled[u] = 1;
+            long long hu = potential[u];
+            for (size_t e = graph.begin(u); e < graph.end(u); e++) {
+                unsigned v = graph.target(e);
+                uint64_t candidate = item.first + (uint64_t) (graph.weight(e) + hu - potential[v]);
+                if (candidate >= reducedDist[v]) continue;
+                if (reducedDist[v] == UNREACHED) touched.push_back(v);
+                reducedDist[v] = candidate;
+                heap.push(candidate, v);
+            }
+        }
+    }
+
+public:
+    /**
+     * Store the graph and compute the potentials
+     * Time Complexity: O(VE) worst case, O(V + E) when no weight is negative
+     * @param V number of vertices
+     * @param edges
+     * @return false if the graph has a negative cycle
+     */
+    bool build(size_t V, const std::vector<Edge> &edges) {
+        graph = CSRGraph<int>(V, edges);
+        reducedDist.assign(V, UNREACHED);
+        settled.assign(V, 0);
+        touched.clear();
+        heap.clear();
+        source = NO_SOURCE;
+        return BellmanFord::potentials(graph, potential, negativeCycle);
+    }
+
+    /**
+     * Time Complexity: O(E + V log C) worst case for the largest reduced distance C,
+     * in practice proportional to the part of the graph closer to A than B
+     * @return the shortest distance from A to B, or UNREACHABLE if B can not be reached from A
+     */
+    long long distance(unsigned A, unsigned B) {
+        if (A != source) {
+            resetSearch();
+            source = A;
+            reducedDist[A] = 0;
+            touched.push_back(A);
+            heap.push(0, A);
+        }
+        searchUntil(B);
+        if (!settled[B]) return UNREACHABLE;
+        return (long long) reducedDist[B] - potential[A] + potential[B];
+    }
+
+    size_t vertexCount() const { return graph.vertexCount(); }
+
+    const CSRGraph<int> &getGraph() const { return graph; }
+
+    /**
+     * @return the potentials of Johnson's reweighting, all 0 if no weight is negative
+     */
+    const std::vector<long long> &getPotential() const { return potential; }
+
+    /**
+     * @return the vertices of a negative cycle in edge order after build returned false, otherwise nothing
+     */
+    const std::vector<unsigned> &getNegativeCycle() const { return negativeCycle; }
+
+    /**
+     * @return bytes of the graph, the potentials and the search state, except the heap that only holds the frontier
+     */
+    size_t memoryBytes() const {
+        return graph.memoryBytes() + potential.capacity() * sizeof(long long) +
+               reducedDist.capacity() * sizeof(uint64_t) + settled.capacity() + touched.capacity() * sizeof(unsigned);
+    }
+};
+
+#endif //VE281P4_SPARSE_P2P_HPP
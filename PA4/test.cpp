@@ -0,0 +1,165 @@
+#include "shortestP2P.hpp"
+
+#include <cstdio>
+#include <map>
+#include <random>
+
+using namespace std;
+
+// Randomized edge updates of the dense engine at 16 bits, against Floyd–Warshall in long long on the same edges
+// Updates that would close a negative cycle or overflow must leave the graph as it was: the distances and
+// next hops right away, and the stored edges, which later updates are repaired from
+// Usage: ./test [number of graphs]
+
+typedef map<pair<unsigned, unsigned>, int> Edges;
+
+const long long NONE = LLONG_MAX;
+
+// all-pairs distances, or nothing if there is a negative cycle
+vector<vector<long long>> reference(unsigned V, const Edges &edges) {
+    vector<vector<long long>> d(V, vector<long long>(V, NONE));
+    for (unsigned i = 0; i < V; i++) d[i][i] = 0;
+    for (auto &edge : edges) d[edge.first.first][edge.first.second] = edge.second;
+    for (unsigned k = 0; k < V; k++) {
+        for (unsigned i = 0; i < V; i++) {
+            for (unsigned j = 0; j < V; j++) {
+                if (d[i][k] != NONE && d[k][j] != NONE) d[i][j] = min(d[i][j], d[i][k] + d[k][j]);
+            }
+        }
+        for (unsigned i = 0; i < V; i++) {
+            if (d[i][i] < 0) return {};
+        }
+    }
+    return d;
+}
+
+bool fits16(const vector<vector<long long>> &d) {
+    for (auto &row : d) {
+        for (long long x : row) {
+            if (x != NONE && (x < INT16_MIN || x >= INT16_MAX)) return false;
+        }
+    }
+    return true;
+}
+
+// distances and, with paths, shortest paths made of existing edges
+bool matches(ShortestP2P &graph, const vector<vector<long long>> &d, const Edges &edges, bool paths) {
+    for (unsigned i = 0; i < d.size(); i++) {
+        for (unsigned j = 0; j < d.size(); j++) {
+            long long got = graph.query(i, j);
+            if (got != (d[i][j] == NONE ? ShortestP2P::UNREACHABLE : d[i][j])) return false;
+            if (!paths || d[i][j] == NONE) continue;
+            vector<unsigned> path = graph.path(i, j);
+            long long length = 0;
+            for (size_t p = 0; p + 1 < path.size(); p++) {
+                auto edge = edges.find({path[p], path[p + 1]});
+                if (edge == edges.end()) return false;
+                length += edge->second;
+            }
+            if (path.front() != i || path.back() != j || length != d[i][j]) return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t graphs = argc > 1 ? stoul(argv[1]) : 200;
+    mt19937 rng(281);
+    size_t failures = 0, overflows = 0, negativeCycles = 0, updates = 0;
+    for (size_t g = 0; g < graphs; g++) {
+        unsigned V = 2 + rng() % 40;
+        size_t E = rng() % (3 * V);
+        bool paths = g % 2;
+        // potentials keep the initial graph free of negative cycles, long edges bring distances near 2^15
+        vector<int> h(V);
+        for (auto &x : h) x = (int) (rng() % 2000);
+        Edges edges;
+        for (size_t e = 0; e < E; e++) {
+            unsigned u = rng() % V, v = rng() % V;
+            if (u != v) edges[{u, v}] = (int) (rng() % 6000) + h[u] - h[v];
+        }
+        auto d = reference(V, edges);
+        if (d.empty() || !fits16(d)) continue;
+
+        FILE *file = tmpfile();
+        fprintf(file, "%u\n%zu\n", V, edges.size());
+        for (auto &edge : edges) fprintf(file, "%u %u %d\n", edge.first.first, edge.first.second, edge.second);
+        fflush(file);
+        rewind(file);
+        ShortestP2P::Options options;
+        options.distanceBits = 16;
+        options.paths = paths;
+        options.updates = true;
+        ShortestP2P graph(options);
+        FastIO::Reader reader(fileno(file));
+        try {
+            graph.readGraph(reader);
+        } catch (const overflow_error &) {
+            // every distance fits, so no sum may be reported as too large
+            printf("graph %zu: overflow when reading it\n", g);
+            failures++;
+            fclose(file);
+            continue;
+        }
+        fclose(file);
+        if (!matches(graph, d, edges, paths)) {
+            printf("graph %zu: wrong distances after reading it\n", g);
+            failures++;
+            continue;
+        }
+
+        for (int step = 0; step < 60; step++) {
+            unsigned u = rng() % V, v = rng() % V;
+            if (u == v) continue;
+            auto found = edges.find({u, v});
+            int before = found == edges.end() ? INT_MAX : found->second;
+            int weight;
+            switch (rng() % 4) {
+                case 0: weight = (int) (rng() % 30000) - 15000; break;            // anything, often too long
+                case 1: weight = before == INT_MAX ? 100 : before - (int) (rng() % 3000); break;
+                case 2: weight = before == INT_MAX ? 100 : before + (int) (rng() % 20000); break;
+                default: weight = (int) (rng() % 3000) + h[u] - h[v];
+            }
+            if (weight == INT16_MAX) continue;     // the largest weight means no edge
+            Edges changed = edges;
+            changed[{u, v}] = weight;
+            auto expected = reference(V, changed);
+            bool weightFits = weight >= INT16_MIN && weight < INT16_MAX;
+            updates++;
+            bool accepted;
+            bool overflowed = false;
+            try {
+                accepted = graph.updateEdge(u, v, weight);
+            } catch (const overflow_error &) {
+                accepted = false;
+                overflowed = true;
+                overflows++;
+            }
+            bool allowed;
+            if (!weightFits) allowed = overflowed;
+            else if (expected.empty()) allowed = !accepted && !overflowed;
+            else if (fits16(expected)) allowed = accepted;
+            else allowed = overflowed;
+            negativeCycles += weightFits && expected.empty();
+            if (!allowed) {
+                printf("graph %zu step %d: update %u -> %u from %d to %d %s\n", g, step, u, v, before, weight,
+                       accepted ? "accepted" : overflowed ? "overflowed" : "refused");
+                failures++;
+                break;
+            }
+            if (accepted) {
+                edges = changed;
+                d = expected;
+            }
+            if (!matches(graph, d, edges, paths)) {
+                printf("graph %zu step %d: wrong distances after an update %s\n", g, step,
+                       accepted ? "accepted" : "refused");
+                failures++;
+                break;
+            }
+        }
+    }
+    printf("%zu updates, %zu overflowed, %zu closed a negative cycle, %zu failures\n", updates, overflows,
+           negativeCycles, failures);
+    return failures ? 1 : 0;
+}